@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Размер кэш-линии. Данные, которые меняют разные потоки, разносятся по разным линиям, чтобы избежать ложного разделения,
+// а начало массивов выравнивается по линии, чтобы группы соседних элементов не пересекали её границу
+constexpr size_t cache_line_size = 64;
+
+// Аллокатор, выравнивающий начало буфера по границе кэш-линии
+template <class T>
+struct CacheAlignedAllocator
+{
+	typedef T value_type;
+
+	CacheAlignedAllocator() = default;
+	template <class U>
+	CacheAlignedAllocator(const CacheAlignedAllocator<U>&)
+	{
+	}
+
+	T* allocate(size_t n);
+	void deallocate(T* pointer, size_t n);
+
+	template <class U>
+	bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+	template <class U>
+	bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+};
+
+template <class T>
+T* CacheAlignedAllocator<T>::allocate(size_t n)
+{
+	// Выделяем с запасом и сохраняем исходный указатель непосредственно перед выровненным блоком
+	char* raw = static_cast<char*>(::operator new(n * sizeof(T) + cache_line_size + sizeof(void*)));
+	const auto address = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+	const uintptr_t aligned = (address + cache_line_size - 1) & ~static_cast<uintptr_t>(cache_line_size - 1);
+	reinterpret_cast<void**>(aligned)[-1] = raw;
+	return reinterpret_cast<T*>(aligned);
+}
+
+template <class T>
+void CacheAlignedAllocator<T>::deallocate(T* pointer, size_t)
+{
+	::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+}
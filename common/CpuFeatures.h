@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <chrono>
+
+// Определение возможностей процессора во время выполнения. Векторный код компилируется только для x86
+// и вызывается, только если процессор и операционная система поддерживают нужный набор инструкций
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include <immintrin.h>
+#else
+#define CPU_X86 0
+#endif
+
+namespace cpu
+{
+#if CPU_X86 && defined(_MSC_VER)
+	// Поддерживает ли процессор и операционная система (сохранение регистров) AVX2 и AVX-512F
+	inline bool supports(bool avx512)
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool os_saves_registers = (info[2] & (1 << 27)) != 0;
+		if (!os_saves_registers)
+			return false;
+		const unsigned long long enabled_state = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		if (!avx512)
+			return (enabled_state & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+		return (enabled_state & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+	}
+
+	inline bool supports_avx2() { return supports(false); }
+	inline bool supports_avx512() { return supports(true); }
+#elif CPU_X86
+	inline bool supports_avx2() { return __builtin_cpu_supports("avx2"); }
+	inline bool supports_avx512() { return __builtin_cpu_supports("avx512f"); }
+#else
+	inline bool supports_avx2() { return false; }
+	inline bool supports_avx512() { return false; }
+#endif
+
+	// Единица измерения timestamp: такты на x86, иначе наносекунды
+	constexpr const char* timestamp_unit = CPU_X86 ? "cycles" : "ns";
+
+	// Отметка времени для замеров коротких участков кода
+	inline unsigned long long timestamp()
+	{
+#if CPU_X86
+		return __rdtsc();
+#else
+		return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Разбиение работы между потоками, общее для всех задач
+namespace parallel
+{
+	// Количество потоков по умолчанию. hardware_concurrency возвращает 0, если определить его не удалось
+	inline unsigned default_threads_count()
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Начало части index при делении [0, n) на parts_count почти равных частей
+	inline size_t chunk_begin(size_t n, unsigned parts_count, unsigned index)
+	{
+		return n * index / parts_count;
+	}
+
+	// Выполняет action(index) для каждого index из [0, count), каждый вызов - в своём потоке
+	template <class Action>
+	void for_each_index(unsigned count, Action action)
+	{
+		if (count == 1)
+		{
+			action(0u);
+			return;
+		}
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < count; ++i)
+			threads.emplace_back(action, i);
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// Выполняет action(thread_index, begin, end) для threads_count частей [0, n) параллельно.
+	// При threads_count == 0 работает как с одним потоком
+	template <class Action>
+	void for_each_chunk(size_t n, unsigned threads_count, Action action)
+	{
+		threads_count = std::max(1u, threads_count);
+		for_each_index(threads_count, [n, threads_count, &action](unsigned thread)
+		{
+			action(thread, chunk_begin(n, threads_count, thread), chunk_begin(n, threads_count, thread + 1));
+		});
+	}
+}
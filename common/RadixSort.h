@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "Parallel.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Поразрядная сортировка (LSD) целых 32- и 64-битных ключей, знаковых и беззнаковых, по 8 бит за проход.
+// Массив делится на threads_count частей: каждый поток считает гистограмму своей части,
+// по гистограммам вычисляются позиции каждого потока в каждой корзине, и потоки раскладывают свои части одновременно.
+// Проходы, в которых у всех ключей одинаковый разряд, пропускаются. Короткие массивы сортируются std::sort.
+namespace radix
+{
+	constexpr size_t small_array_size = 256; // До этого размера быстрее сравнения
+	constexpr size_t min_elements_per_thread = 1 << 16; // Меньшие части не окупают запуск потока
+
+	// Беззнаковое представление ключа, сохраняющее порядок: у знаковых инвертируется старший бит
+	template <class Key>
+	typename std::make_unsigned<Key>::type to_unsigned(Key key)
+	{
+		typedef typename std::make_unsigned<Key>::type unsigned_key;
+		const unsigned_key sign_flip = std::is_signed<Key>::value ? unsigned_key(1) << (sizeof(Key) * 8 - 1) : 0;
+		return static_cast<unsigned_key>(key) ^ sign_flip;
+	}
+
+	template <class Key>
+	size_t digit(Key key, int shift)
+	{
+		return static_cast<size_t>((to_unsigned(key) >> shift) & 0xFF);
+	}
+}
+
+// Сортирует по возрастанию n ключей массива values, используя до threads_count потоков.
+// buffer - вспомогательный массив не меньше чем из n элементов. В однопоточном режиме сортировка не выделяет память
+template <class Key>
+void radix_sort(Key* values, size_t n, Key* buffer, unsigned threads_count = 1)
+{
+	static_assert(std::is_integral<Key>::value && (sizeof(Key) == 4 || sizeof(Key) == 8),
+		"radix_sort supports 32- and 64-bit integer keys");
+	if (n <= radix::small_array_size)
+	{
+		std::sort(values, values + n);
+		return;
+	}
+	threads_count = static_cast<unsigned>(std::max<size_t>(1,
+		std::min<size_t>(threads_count, n / radix::min_elements_per_thread)));
+
+	Key* source = values;
+	Key* destination = buffer;
+	// histograms[256 * t + d] - количество ключей с разрядом d в части потока t, затем - позиция записи этого потока
+	size_t single_histogram[256];
+	std::vector<size_t> thread_histograms;
+	if (threads_count > 1)
+		thread_histograms.resize(256 * static_cast<size_t>(threads_count));
+	size_t* histograms = threads_count > 1 ? thread_histograms.data() : single_histogram;
+
+	for (int shift = 0; shift < static_cast<int>(sizeof(Key) * 8); shift += 8)
+	{
+		parallel::for_each_chunk(n, threads_count, [&](unsigned thread, size_t begin, size_t end)
+		{
+			size_t* histogram = histograms + 256 * static_cast<size_t>(thread);
+			std::fill(histogram, histogram + 256, 0);
+			for (size_t i = begin; i < end; ++i)
+				++histogram[radix::digit(source[i], shift)];
+		});
+
+		// Если все ключи попали в одну корзину, проход ничего не меняет
+		bool trivial_pass = false;
+		for (size_t d = 0; d < 256 && !trivial_pass; ++d)
+		{
+			size_t total = 0;
+			for (unsigned t = 0; t < threads_count; ++t)
+				total += histograms[256 * t + d];
+			trivial_pass = total == n;
+		}
+		if (trivial_pass)
+			continue;
+
+		// Корзины идут по возрастанию разряда, внутри корзины - части потоков по порядку: так сортировка остаётся устойчивой
+		size_t offset = 0;
+		for (size_t d = 0; d < 256; ++d)
+		{
+			for (unsigned t = 0; t < threads_count; ++t)
+			{
+				const size_t count = histograms[256 * t + d];
+				histograms[256 * t + d] = offset;
+				offset += count;
+			}
+		}
+
+		parallel::for_each_chunk(n, threads_count, [&](unsigned thread, size_t begin, size_t end)
+		{
+			size_t* positions = histograms + 256 * static_cast<size_t>(thread);
+			for (size_t i = begin; i < end; ++i)
+				destination[positions[radix::digit(source[i], shift)]++] = source[i];
+		});
+		std::swap(source, destination);
+	}
+
+	if (source != values)
+		std::memcpy(values, source, n * sizeof(Key));
+}
+
+// Сортирует по возрастанию n ключей массива values, используя до threads_count потоков
+template <class Key>
+void radix_sort(Key* values, size_t n, unsigned threads_count = 1)
+{
+	if (n <= radix::small_array_size)
+	{
+		std::sort(values, values + n);
+		return;
+	}
+	std::vector<Key> buffer(n);
+	radix_sort(values, n, buffer.data(), threads_count);
+}
@@ -0,0 +1,357 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Файл, отображённый в память только для чтения. Страницы подгружаются по мере обращения,
+// поэтому в оперативной памяти одновременно находится лишь читаемая часть файла
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path);
+	// Содержимое уже открытого потока целиком. Обычный файл отображается в память,
+	// иначе (канал, консоль) поток дочитывается в буфер
+	explicit MappedFile(FILE* stream);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Удалось ли отобразить файл
+	bool is_open() const { return opened && (data != nullptr || length == 0); }
+	const char* begin() const { return data; }
+	const char* end() const { return data + length; }
+	size_t size() const { return length; }
+
+private:
+	const char* data = nullptr;
+	size_t length = 0;
+	bool opened = false;
+	bool mapped = false;
+	std::vector<char> buffer; // Содержимое потока, если отобразить его не удалось
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	// Отображает в память файл, из которого читает stream. Возвращает false, если это не обычный непустой файл
+	bool map_stream(FILE* stream);
+	void read_all(FILE* stream);
+};
+
+inline MappedFile::MappedFile(FILE* stream)
+{
+	opened = true;
+	if (!map_stream(stream))
+		read_all(stream);
+}
+
+#ifdef _WIN32
+inline MappedFile::MappedFile(const std::string& path)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER file_size;
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size))
+		return;
+	opened = true;
+	length = static_cast<size_t>(file_size.QuadPart);
+	if (length == 0)
+		return;
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	mapped = data != nullptr;
+}
+
+inline bool MappedFile::map_stream(FILE* stream)
+{
+	// Дескриптор принадлежит потоку, поэтому в file не сохраняется и не закрывается
+	const auto stream_file = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(stream)));
+	LARGE_INTEGER file_size;
+	if (stream_file == INVALID_HANDLE_VALUE || GetFileType(stream_file) != FILE_TYPE_DISK ||
+		!GetFileSizeEx(stream_file, &file_size) || file_size.QuadPart == 0)
+		return false;
+	mapping = CreateFileMappingW(stream_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return false;
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+		return false;
+	length = static_cast<size_t>(file_size.QuadPart);
+	mapped = true;
+	return true;
+}
+
+inline MappedFile::~MappedFile()
+{
+	if (mapped)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+#else
+inline MappedFile::MappedFile(const std::string& path)
+{
+	const int descriptor = open(path.c_str(), O_RDONLY);
+	struct stat file_stat;
+	if (descriptor < 0)
+		return;
+	if (fstat(descriptor, &file_stat) == 0)
+	{
+		opened = true;
+		length = static_cast<size_t>(file_stat.st_size);
+		if (length > 0)
+		{
+			void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (view != MAP_FAILED)
+			{
+				madvise(view, length, MADV_SEQUENTIAL);
+				data = static_cast<const char*>(view);
+				mapped = true;
+			}
+		}
+	}
+	close(descriptor); // Отображение остаётся действительным и после закрытия дескриптора
+}
+
+inline bool MappedFile::map_stream(FILE* stream)
+{
+	const int descriptor = fileno(stream);
+	struct stat file_stat;
+	if (fstat(descriptor, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+		return false;
+	void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (view == MAP_FAILED)
+		return false;
+	madvise(view, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+	data = static_cast<const char*>(view);
+	length = static_cast<size_t>(file_stat.st_size);
+	mapped = true;
+	return true;
+}
+
+inline MappedFile::~MappedFile()
+{
+	if (mapped)
+		munmap(const_cast<char*>(data), length);
+}
+#endif
+
+inline void MappedFile::read_all(FILE* stream)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stream), _O_BINARY); // Без перевода строк и обработки Ctrl+Z
+#endif
+	const size_t chunk_size = 1 << 20;
+	size_t filled = 0;
+	while (true)
+	{
+		buffer.resize(filled + chunk_size);
+		const size_t read = std::fread(buffer.data() + filled, 1, chunk_size, stream);
+		filled += read;
+		if (read < chunk_size)
+			break;
+	}
+	buffer.resize(filled);
+	data = buffer.data();
+	length = filled;
+}
+
+// Последовательное чтение целых чисел, разделённых пробельными символами.
+// Читает либо поток блоками фиксированного размера, либо готовую область памяти (например, MappedFile).
+// Цифры разбираются по 8 за раз внутри 64-битного слова (SWAR): одна маска находит длину серии цифр,
+// три умножения переводят до 8 цифр в число. Последние байты блока разбираются посимвольно
+class IntegerReader
+{
+public:
+	explicit IntegerReader(FILE* stream, size_t chunk_size = 1 << 16);
+	IntegerReader(const char* begin, const char* end);
+
+	// Записывает в value следующее число. Возвращает false, если чисел больше нет
+	bool next(long long& value);
+
+private:
+	FILE* stream = nullptr;
+	std::vector<char> buffer;
+	const char* position = nullptr;
+	const char* end = nullptr;
+
+	// Текущий символ или EOF, если данные закончились. При необходимости дочитывает поток
+	int peek();
+
+	// Количество цифр подряд в начале слова chunk (от 0 до 8)
+	static int leading_digits(uint64_t chunk);
+	// Значение digits_count первых цифр слова chunk
+	static uint32_t parse_digits(uint64_t chunk, int digits_count);
+};
+
+inline IntegerReader::IntegerReader(FILE* stream, size_t chunk_size) : stream(stream), buffer(chunk_size)
+{
+	position = end = buffer.data();
+}
+
+inline IntegerReader::IntegerReader(const char* begin, const char* end) : position(begin), end(end)
+{
+}
+
+inline int IntegerReader::peek()
+{
+	if (position == end)
+	{
+		if (!stream)
+			return EOF;
+		const size_t read = std::fread(buffer.data(), 1, buffer.size(), stream);
+		position = buffer.data();
+		end = position + read;
+		if (read == 0)
+			return EOF;
+	}
+	return static_cast<unsigned char>(*position);
+}
+
+inline int IntegerReader::leading_digits(uint64_t chunk)
+{
+	// Байт - цифра, если его старшая тетрада равна 3 и после прибавления 6 остаётся равной 3.
+	// Перенос из байта >= 0xFA портит только более поздние байты, а серия цифр к тому моменту уже прервана
+	const uint64_t high_nibbles = 0xF0F0F0F0F0F0F0F0ULL;
+	const uint64_t threes = 0x3030303030303030ULL;
+	const uint64_t not_digits = ((chunk & high_nibbles) ^ threes) |
+		(((chunk + 0x0606060606060606ULL) & high_nibbles) ^ threes);
+	if (not_digits == 0)
+		return 8;
+	int bit = 0;
+	while (((not_digits >> bit) & 0xFF) == 0)
+		bit += 8;
+	return bit / 8;
+}
+
+inline uint32_t IntegerReader::parse_digits(uint64_t chunk, int digits_count)
+{
+	// Первый символ лежит в младшем байте. Сдвиг влево дописывает недостающие ведущие нули
+	uint64_t value = (chunk & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - digits_count));
+	value = value * 10 + (value >> 8); // Пары цифр
+	value = (((value & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+		(((value >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32; // Четвёрки и восьмёрка
+	return static_cast<uint32_t>(value);
+}
+
+inline bool IntegerReader::next(long long& value)
+{
+	int symbol = peek();
+	while (symbol == ' ' || symbol == '\n' || symbol == '\r' || symbol == '\t')
+	{
+		++position;
+		symbol = peek();
+	}
+	if (symbol == EOF)
+		return false;
+
+	const bool negative = symbol == '-';
+	if (negative || symbol == '+')
+	{
+		++position;
+		symbol = peek();
+	}
+	unsigned long long magnitude = 0;
+	while (end - position >= 8)
+	{
+		uint64_t chunk;
+		std::memcpy(&chunk, position, sizeof(chunk));
+		const int digits_count = leading_digits(chunk);
+		if (digits_count == 0)
+			break;
+		static const uint64_t powers_of_ten[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+		magnitude = magnitude * powers_of_ten[digits_count] + parse_digits(chunk, digits_count);
+		position += digits_count;
+		if (digits_count < 8)
+		{
+			value = static_cast<long long>(negative ? 0 - magnitude : magnitude);
+			return true;
+		}
+		symbol = peek();
+	}
+	while (symbol >= '0' && symbol <= '9')
+	{
+		magnitude = magnitude * 10 + static_cast<unsigned long long>(symbol - '0');
+		++position;
+		symbol = peek();
+	}
+	value = static_cast<long long>(negative ? 0 - magnitude : magnitude);
+	return true;
+}
+
+// Буферизованный вывод целых чисел через пробел
+class BufferedWriter
+{
+public:
+	explicit BufferedWriter(FILE* stream, size_t buffer_size = 1 << 16);
+	~BufferedWriter();
+
+	BufferedWriter(const BufferedWriter&) = delete;
+	BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+	// Выводит value и пробел после него
+	void write(long long value);
+	void flush();
+
+private:
+	FILE* stream;
+	std::vector<char> buffer;
+	size_t filled = 0;
+};
+
+inline BufferedWriter::BufferedWriter(FILE* stream, size_t buffer_size) : stream(stream), buffer(buffer_size)
+{
+}
+
+inline BufferedWriter::~BufferedWriter()
+{
+	flush();
+}
+
+inline void BufferedWriter::write(long long value)
+{
+	const size_t max_length = 21; // Знак, 19 цифр и пробел
+	if (buffer.size() - filled < max_length)
+		flush();
+	char digits[20];
+	int digits_count = 0;
+	unsigned long long magnitude = value < 0 ? 0 - static_cast<unsigned long long>(value) : value;
+	do
+	{
+		digits[digits_count++] = static_cast<char>('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0)
+		buffer[filled++] = '-';
+	while (digits_count > 0)
+		buffer[filled++] = digits[--digits_count];
+	buffer[filled++] = ' ';
+}
+
+inline void BufferedWriter::flush()
+{
+	std::fwrite(buffer.data(), 1, filled, stream);
+	std::fflush(stream);
+	filled = 0;
+}
@@ -0,0 +1,157 @@
+﻿#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Очередь на связном списке блоков фиксированного размера.
+// В отличие от очереди на двух стеках, каждая операция выполняется за O(1) в худшем случае:
+// элементы никогда не перекладываются, а при переходе через границу блока выделяется или освобождается один блок.
+// Один освободившийся блок сохраняется про запас, чтобы очередь, колеблющаяся около границы, не обращалась к куче.
+template <class T, size_t BlockSize = 1024>
+class BlockQueue
+{
+public:
+	BlockQueue() = default;
+	~BlockQueue();
+
+	BlockQueue(const BlockQueue&) = delete;
+	BlockQueue& operator=(const BlockQueue&) = delete;
+
+	// Проверка очереди на пустоту
+	bool empty() const;
+	// Добавление элемента
+	void push(const T& value);
+	void push(T&& value);
+	// Конструирование элемента в конце очереди из аргументов args
+	template <class... Args>
+	T& emplace(Args&&... args);
+	// Извлечение
+	T pop();
+	// Количество элементов в очереди
+	int size() const;
+
+private:
+	struct Block
+	{
+		alignas(T) unsigned char storage[BlockSize * sizeof(T)];
+		Block* next = nullptr;
+
+		T* at(size_t index) { return reinterpret_cast<T*>(storage) + index; }
+	};
+
+	Block* head_block = nullptr; // Блок, из которого извлекаются элементы
+	Block* tail_block = nullptr; // Блок, в который добавляются элементы
+	Block* spare_block = nullptr; // Пустой блок про запас
+	size_t head_index = 0; // Позиция первого элемента в head_block
+	size_t tail_index = BlockSize; // Позиция за последним элементом в tail_block
+	size_t count = 0; // Количество элементов в очереди
+
+	Block* acquire_block();
+	void release_block(Block* block);
+};
+
+template <class T, size_t BlockSize>
+BlockQueue<T, BlockSize>::~BlockQueue()
+{
+	while (!empty())
+		pop();
+	delete head_block;
+	delete spare_block;
+}
+
+template <class T, size_t BlockSize>
+bool BlockQueue<T, BlockSize>::empty() const
+{
+	return count == 0;
+}
+
+template <class T, size_t BlockSize>
+typename BlockQueue<T, BlockSize>::Block* BlockQueue<T, BlockSize>::acquire_block()
+{
+	if (!spare_block)
+		return new Block;
+	Block* block = spare_block;
+	spare_block = nullptr;
+	block->next = nullptr;
+	return block;
+}
+
+template <class T, size_t BlockSize>
+void BlockQueue<T, BlockSize>::release_block(Block* block)
+{
+	if (spare_block)
+		delete block;
+	else
+		spare_block = block;
+}
+
+template <class T, size_t BlockSize>
+void BlockQueue<T, BlockSize>::push(const T& value)
+{
+	emplace(value);
+}
+
+template <class T, size_t BlockSize>
+void BlockQueue<T, BlockSize>::push(T&& value)
+{
+	emplace(std::move(value));
+}
+
+template <class T, size_t BlockSize>
+template <class... Args>
+T& BlockQueue<T, BlockSize>::emplace(Args&&... args)
+{
+	if (tail_index == BlockSize)
+	{
+		Block* block = acquire_block();
+		if (tail_block)
+			tail_block->next = block;
+		else
+			head_block = block;
+		tail_block = block;
+		tail_index = 0;
+	}
+	T* element = new (tail_block->at(tail_index)) T(std::forward<Args>(args)...);
+	++tail_index;
+	++count;
+	return *element;
+}
+
+template <class T, size_t BlockSize>
+T BlockQueue<T, BlockSize>::pop()
+{
+	assert(!empty());
+	T* front = head_block->at(head_index);
+	T value(std::move(*front));
+	front->~T();
+	++head_index;
+	--count;
+	if (head_index == BlockSize)
+	{
+		// Блок исчерпан: переходим к следующему
+		Block* exhausted = head_block;
+		head_block = exhausted->next;
+		head_index = 0;
+		if (!head_block)
+		{
+			tail_block = nullptr;
+			tail_index = BlockSize;
+		}
+		release_block(exhausted);
+	}
+	else if (count == 0)
+	{
+		// Очередь опустела посреди блока: начинаем его заново, чтобы не держать частично использованный блок
+		head_index = 0;
+		tail_index = 0;
+	}
+	return value;
+}
+
+template <class T, size_t BlockSize>
+int BlockQueue<T, BlockSize>::size() const
+{
+	return static_cast<int>(count);
+}
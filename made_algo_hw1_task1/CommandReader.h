@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include "../common/StreamIO.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Команда над очередью: 3 - push value, 2 - pop с ожиданием value
+struct Command
+{
+	int32_t command;
+	int32_t value;
+};
+
+// Бинарный формат команд: 8 байт binary_commands_magic, количество команд (uint64) и массив Command.
+// Записи лежат по смещению 16 и выровнены, поэтому отображённый файл используется как массив без разбора
+const char binary_commands_magic[8] = { 'Q', 'C', 'M', 'D', 'B', 'I', 'N', '1' };
+constexpr size_t binary_commands_header_size = 16;
+
+// Команды, прочитанные из потока. В бинарном формате указывают прямо в отображённую память, в текстовом - в storage
+struct CommandList
+{
+	const Command* data = nullptr;
+	size_t size = 0;
+	std::vector<Command> storage;
+};
+
+// Разбирает содержимое input в бинарном или текстовом формате (первое число - количество команд, далее пары "команда значение").
+// В тексте недостающие числа считаются нулями, как при чтении через std::cin: первая недочитанная команда
+// выполняется с нулевым значением, а если объявлено больше команд, за ней следует неизвестная команда 0.
+// Возвращает false, если в бинарных данных команд меньше объявленного количества
+inline bool load_commands(const MappedFile& input, CommandList& commands)
+{
+	if (input.size() >= binary_commands_header_size &&
+		std::memcmp(input.begin(), binary_commands_magic, sizeof(binary_commands_magic)) == 0)
+	{
+		uint64_t count = 0;
+		std::memcpy(&count, input.begin() + sizeof(binary_commands_magic), sizeof(count));
+		const uint64_t available = (input.size() - binary_commands_header_size) / sizeof(Command);
+		commands.data = reinterpret_cast<const Command*>(input.begin() + binary_commands_header_size);
+		commands.size = static_cast<size_t>(count < available ? count : available);
+		return count <= available;
+	}
+
+	IntegerReader reader(input.begin(), input.end());
+	long long n = 0;
+	if (!reader.next(n) || static_cast<int32_t>(n) < 0)
+		n = 0;
+	n = static_cast<int32_t>(n); // Количество команд - 32-битное, как и их поля
+	// Команда с пробелами занимает не меньше 4 байт, поэтому завышенное n не раздувает резерв
+	commands.storage.reserve(static_cast<size_t>(std::min<long long>(n, static_cast<long long>(input.size() / 4) + 1)));
+	for (long long i = 0; i < n; ++i)
+	{
+		long long command = 0;
+		long long value = 0;
+		const bool complete = reader.next(command) && reader.next(value);
+		commands.storage.push_back(Command{ static_cast<int32_t>(command), static_cast<int32_t>(value) });
+		if (!complete)
+		{
+			if (i + 1 < n)
+				commands.storage.push_back(Command{ 0, 0 });
+			break;
+		}
+	}
+	commands.data = commands.storage.data();
+	commands.size = commands.storage.size();
+	return true;
+}
+
+// Записывает команды в бинарном формате
+inline void write_binary_commands(const CommandList& commands, FILE* stream)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stream), _O_BINARY);
+#endif
+	const uint64_t count = commands.size;
+	std::fwrite(binary_commands_magic, 1, sizeof(binary_commands_magic), stream);
+	std::fwrite(&count, sizeof(count), 1, stream);
+	std::fwrite(commands.data, sizeof(Command), commands.size, stream);
+}
@@ -0,0 +1,211 @@
+﻿#pragma once
+
+#include "../common/CacheLine.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+// Ограниченная очередь для многих производителей и многих потребителей (схема Вьюкова).
+// Каждая ячейка хранит номер последовательности: ячейка свободна для позиции pos, если номер равен pos,
+// и содержит элемент для позиции pos, если номер равен pos + 1.
+// Пакетные операции захватывают сразу несколько позиций одним compare_exchange и затем заполняют/читают ячейки по порядку.
+// Если ячейку из захваченного диапазона ещё не освободил (не опубликовал) другой поток, операция дожидается его.
+template <class T>
+class MpmcQueue
+{
+public:
+	explicit MpmcQueue(size_t min_capacity = 1 << 16);
+	~MpmcQueue();
+
+	MpmcQueue(const MpmcQueue&) = delete;
+	MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+	// Добавление без ожидания. Возвращает false, если очередь заполнена
+	bool try_push(const T& value);
+	// Извлечение без ожидания. Возвращает false, если очередь пуста
+	bool try_pop(T& value);
+	// Добавляет первые элементы массива values (не больше count) и возвращает их количество
+	size_t try_push_bulk(const T* values, size_t count);
+	// Извлекает в out не больше count элементов и возвращает их количество
+	size_t try_pop_bulk(T* out, size_t count);
+	// Приблизительное количество элементов: при параллельных операциях значение может сразу устареть
+	int size() const;
+	bool empty() const;
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	alignas(cache_line_size) std::atomic<size_t> enqueue_pos{ 0 };
+	alignas(cache_line_size) std::atomic<size_t> dequeue_pos{ 0 };
+	alignas(cache_line_size) size_t capacity = 1; // Размер буфера, степень двойки
+	size_t mask = 0;
+	Cell* cells = nullptr;
+
+	// Ждёт, пока номер последовательности ячейки не станет равным expected
+	static void wait_for_sequence(const Cell& cell, size_t expected);
+};
+
+template <class T>
+MpmcQueue<T>::MpmcQueue(size_t min_capacity)
+{
+	while (capacity < min_capacity)
+		capacity *= 2;
+	mask = capacity - 1;
+	cells = new Cell[capacity];
+	for (size_t i = 0; i < capacity; ++i)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <class T>
+MpmcQueue<T>::~MpmcQueue()
+{
+	delete[] cells;
+}
+
+template <class T>
+void MpmcQueue<T>::wait_for_sequence(const Cell& cell, size_t expected)
+{
+	while (cell.sequence.load(std::memory_order_acquire) != expected)
+		std::this_thread::yield();
+}
+
+template <class T>
+bool MpmcQueue<T>::try_push(const T& value)
+{
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	Cell* cell = nullptr;
+	while (true)
+	{
+		cell = &cells[pos & mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+		if (diff == 0)
+		{
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) // Ячейка ещё занята элементом предыдущего круга
+			return false;
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+	cell->data = value;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template <class T>
+bool MpmcQueue<T>::try_pop(T& value)
+{
+	size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+	Cell* cell = nullptr;
+	while (true)
+	{
+		cell = &cells[pos & mask];
+		const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos + 1);
+		if (diff == 0)
+		{
+			if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) // Элемент в ячейку ещё не записан
+			return false;
+		else
+			pos = dequeue_pos.load(std::memory_order_relaxed);
+	}
+	value = std::move(cell->data);
+	cell->sequence.store(pos + capacity, std::memory_order_release);
+	return true;
+}
+
+template <class T>
+size_t MpmcQueue<T>::try_push_bulk(const T* values, size_t count)
+{
+	if (count == 0)
+		return 0;
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	size_t claimed = 0;
+	while (true)
+	{
+		const size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+		if (diff == 0)
+		{
+			// Позиции до dequeue_pos + capacity уже захвачены потребителями и скоро освободятся
+			const auto used = static_cast<ptrdiff_t>(pos - dequeue_pos.load(std::memory_order_acquire));
+			const size_t free_cells = capacity - static_cast<size_t>(std::max<ptrdiff_t>(used, 0));
+			claimed = std::min(count, free_cells);
+			if (claimed > 0 && enqueue_pos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+				break;
+			if (claimed == 0)
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+		else if (diff < 0)
+			return 0;
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+	for (size_t i = 0; i < claimed; ++i)
+	{
+		Cell& cell = cells[(pos + i) & mask];
+		wait_for_sequence(cell, pos + i);
+		cell.data = values[i];
+		cell.sequence.store(pos + i + 1, std::memory_order_release);
+	}
+	return claimed;
+}
+
+template <class T>
+size_t MpmcQueue<T>::try_pop_bulk(T* out, size_t count)
+{
+	if (count == 0)
+		return 0;
+	size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+	size_t claimed = 0;
+	while (true)
+	{
+		const size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos + 1);
+		if (diff == 0)
+		{
+			// Позиции до enqueue_pos уже захвачены производителями и скоро будут заполнены
+			const auto available = static_cast<ptrdiff_t>(enqueue_pos.load(std::memory_order_acquire) - pos);
+			claimed = std::min(count, static_cast<size_t>(std::max<ptrdiff_t>(available, 1)));
+			if (dequeue_pos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return 0;
+		else
+			pos = dequeue_pos.load(std::memory_order_relaxed);
+	}
+	for (size_t i = 0; i < claimed; ++i)
+	{
+		Cell& cell = cells[(pos + i) & mask];
+		wait_for_sequence(cell, pos + i + 1);
+		out[i] = std::move(cell.data);
+		cell.sequence.store(pos + i + capacity, std::memory_order_release);
+	}
+	return claimed;
+}
+
+template <class T>
+int MpmcQueue<T>::size() const
+{
+	const size_t current_dequeue = dequeue_pos.load(std::memory_order_acquire);
+	const size_t current_enqueue = enqueue_pos.load(std::memory_order_acquire);
+	return static_cast<int>(std::max<ptrdiff_t>(static_cast<ptrdiff_t>(current_enqueue - current_dequeue), 0));
+}
+
+template <class T>
+bool MpmcQueue<T>::empty() const
+{
+	return size() == 0;
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include "../common/CacheLine.h"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+// Очередь на кольцевом буфере для одного производителя и одного потребителя без блокировок.
+// push/try_push вызываются только из потока-производителя, pop/try_pop - только из потока-потребителя.
+// Ёмкость округляется вверх до степени двойки, чтобы позиция в буфере вычислялась маской.
+class SpscQueue
+{
+public:
+	explicit SpscQueue(size_t min_capacity = 1 << 16);
+	~SpscQueue();
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Проверка очереди на пустоту
+	bool empty() const;
+	// Добавление элемента. Если буфер заполнен, ждёт, пока потребитель освободит место
+	void push(int value);
+	// Извлечение. Если очередь пуста, ждёт, пока производитель добавит элемент
+	int pop();
+	// Количество элементов в очереди
+	int size() const;
+
+	// Добавление без ожидания. Возвращает false, если буфер заполнен
+	bool try_push(int value);
+	// Извлечение без ожидания. Возвращает false, если очередь пуста
+	bool try_pop(int& value);
+
+private:
+	// Индексы только растут, позиция в буфере получается как index & mask.
+	// head меняет только потребитель, tail - только производитель.
+	// Рядом с каждым индексом лежит копия чужого индекса, которую поток обновляет лишь при видимой нехватке места/элементов
+	alignas(cache_line_size) std::atomic<size_t> head{ 0 };
+	size_t cached_tail = 0; // Последнее прочитанное потребителем значение tail
+	alignas(cache_line_size) std::atomic<size_t> tail{ 0 };
+	size_t cached_head = 0; // Последнее прочитанное производителем значение head
+	alignas(cache_line_size) size_t capacity = 1; // Размер буфера
+	size_t mask = 0;
+	int* buffer = nullptr;
+};
+
+inline SpscQueue::SpscQueue(size_t min_capacity)
+{
+	while (capacity < min_capacity)
+		capacity *= 2;
+	mask = capacity - 1;
+	buffer = new int[capacity];
+}
+
+inline SpscQueue::~SpscQueue()
+{
+	delete[] buffer;
+}
+
+inline bool SpscQueue::empty() const
+{
+	return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
+
+inline bool SpscQueue::try_push(int value)
+{
+	const size_t current_tail = tail.load(std::memory_order_relaxed);
+	if (current_tail - cached_head == capacity)
+	{
+		cached_head = head.load(std::memory_order_acquire);
+		if (current_tail - cached_head == capacity)
+			return false;
+	}
+	buffer[current_tail & mask] = value;
+	tail.store(current_tail + 1, std::memory_order_release); // Публикуем элемент потребителю
+	return true;
+}
+
+inline bool SpscQueue::try_pop(int& value)
+{
+	const size_t current_head = head.load(std::memory_order_relaxed);
+	if (current_head == cached_tail)
+	{
+		cached_tail = tail.load(std::memory_order_acquire);
+		if (current_head == cached_tail)
+			return false;
+	}
+	value = buffer[current_head & mask];
+	head.store(current_head + 1, std::memory_order_release); // Возвращаем ячейку производителю
+	return true;
+}
+
+inline void SpscQueue::push(int value)
+{
+	while (!try_push(value))
+		std::this_thread::yield();
+}
+
+inline int SpscQueue::pop()
+{
+	int value = 0;
+	while (!try_pop(value))
+		std::this_thread::yield();
+	return value;
+}
+
+inline int SpscQueue::size() const
+{
+	// head читается первым: пока читаем tail, он может только вырасти, и разность не станет отрицательной
+	const size_t current_head = head.load(std::memory_order_acquire);
+	const size_t current_tail = tail.load(std::memory_order_acquire);
+	return static_cast<int>(current_tail - current_head);
+}
@@ -1,125 +1,521 @@
 ﻿// 1_3. Реализовать очередь с помощью двух стеков. Использовать стек, реализованный с помощью динамического буфера.
 //
 
+#include "BlockQueue.h"
+#include "CommandReader.h"
+#include "MpmcQueue.h"
+#include "SpscQueue.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Стек на динамическом буфере.
+// Первые InlineN элементов хранятся внутри самого объекта, к куче стек обращается только при переполнении
+template <class T, size_t InlineN = 32>
 class Stack
 {
 public:
+	Stack() = default;
 	~Stack();
 
+	Stack(const Stack&) = delete;
+	Stack& operator=(const Stack&) = delete;
+
 	// Проверка стека на пустоту
 	bool empty() const;
 	// Добавление элемента
-	void push(int value);
+	void push(const T& value);
+	void push(T&& value);
+	// Конструирование элемента на вершине стека из аргументов args
+	template <class... Args>
+	T& emplace(Args&&... args);
+	// Добавление элементов диапазона [first, last) в порядке их следования
+	template <class InputIt>
+	void push_range(InputIt first, InputIt last);
 	// Извлечение
-	int pop();
+	T pop();
+	// Извлекает items_count элементов и записывает их в out в порядке извлечения. Возвращает итератор за последним записанным
+	template <class OutputIt>
+	OutputIt pop_into(OutputIt out, int items_count);
+	// Перекладывает все элементы в стек target в порядке извлечения
+	template <size_t OtherN>
+	void pop_into(Stack<T, OtherN>& target);
 	// Количество элементов в стеке
 	int size() const;
 
 private:
-	int capacity = 32; // Размер буфера
-	int count = 0; // Количество элементов в стеке
-	int* buffer = new int[capacity];
+	template <class U, size_t OtherN>
+	friend class Stack;
+
+	// Сырая память под InlineN элементов; объекты в ней создаются размещающим new
+	alignas(T) unsigned char inline_buffer[(InlineN > 0 ? InlineN : 1) * sizeof(T)];
+	T* buffer = reinterpret_cast<T*>(inline_buffer);
+	size_t capacity = InlineN; // Размер буфера
+	size_t count = 0; // Количество элементов в стеке
+
+	bool is_inline() const;
+	// Гарантирует, что в буфере поместится хотя бы required элементов
+	void reserve(size_t required);
+	// Переносит count элементов из from в неинициализированную память to. Тривиальные типы копируются memcpy
+	static void relocate(T* from, size_t count, T* to, std::true_type);
+	static void relocate(T* from, size_t count, T* to, std::false_type);
 };
 
+template <class T, size_t InlineN = 32>
 class Queue
 {
 public:
-	~Queue();
-
 	// Проверка очереди на пустоту
 	bool empty() const;
 	// Добавление элемента
-	void push(int value);
+	void push(const T& value);
+	void push(T&& value);
+	// Конструирование элемента в конце очереди из аргументов args
+	template <class... Args>
+	T& emplace(Args&&... args);
+	// Добавление элементов диапазона [first, last) в порядке их следования
+	template <class InputIt>
+	void push_range(InputIt first, InputIt last);
 	// Извлечение
-	int pop();
+	T pop();
+	// Извлекает items_count элементов и записывает их в out в порядке извлечения. Возвращает итератор за последним записанным
+	template <class OutputIt>
+	OutputIt pop_into(OutputIt out, int items_count);
 	// Количество элементов в очереди
 	int size() const;
 
 private:
-	Stack* forward_stack = new Stack(); // Стек для операции push
-	Stack* backward_stack = new Stack(); // Стек для операции pop
+	Stack<T, InlineN> forward_stack; // Стек для операции push
+	Stack<T, InlineN> backward_stack; // Стек для операции pop
 };
 
-Stack::~Stack()
+template <class T, size_t InlineN>
+Stack<T, InlineN>::~Stack()
 {
-	delete[] buffer;
+	for (size_t i = 0; i < count; ++i)
+		buffer[i].~T();
+	if (!is_inline())
+		::operator delete(buffer);
 }
 
-bool Stack::empty() const
+template <class T, size_t InlineN>
+bool Stack<T, InlineN>::empty() const
 {
 	return count == 0;
 }
 
-void Stack::push(int value)
+template <class T, size_t InlineN>
+bool Stack<T, InlineN>::is_inline() const
 {
-	if (count == capacity)
+	return buffer == reinterpret_cast<const T*>(inline_buffer);
+}
+
+template <class T, size_t InlineN>
+void Stack<T, InlineN>::relocate(T* from, size_t count, T* to, std::true_type)
+{
+	if (count > 0)
+		std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(T));
+}
+
+template <class T, size_t InlineN>
+void Stack<T, InlineN>::relocate(T* from, size_t count, T* to, std::false_type)
+{
+	for (size_t i = 0; i < count; ++i)
 	{
-		int* new_buffer = new int[capacity * 2];
-		for (int i = 0; i < capacity; ++i)
-			new_buffer[i] = buffer[i];
-		delete[] buffer;
-		buffer = new_buffer;
-		capacity *= 2;
+		new (to + i) T(std::move_if_noexcept(from[i]));
+		from[i].~T();
 	}
-	buffer[count++] = value;
 }
 
-int Stack::pop()
+template <class T, size_t InlineN>
+void Stack<T, InlineN>::reserve(size_t required)
+{
+	if (required <= capacity)
+		return;
+	size_t new_capacity = capacity > 0 ? capacity * 2 : 1;
+	while (new_capacity < required)
+		new_capacity *= 2;
+	T* new_buffer = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+	relocate(buffer, count, new_buffer, std::is_trivially_copyable<T>());
+	if (!is_inline())
+		::operator delete(buffer);
+	buffer = new_buffer;
+	capacity = new_capacity;
+}
+
+template <class T, size_t InlineN>
+void Stack<T, InlineN>::push(const T& value)
+{
+	emplace(value);
+}
+
+template <class T, size_t InlineN>
+void Stack<T, InlineN>::push(T&& value)
+{
+	emplace(std::move(value));
+}
+
+template <class T, size_t InlineN>
+template <class... Args>
+T& Stack<T, InlineN>::emplace(Args&&... args)
+{
+	if (count == capacity)
+		reserve(count + 1);
+	T* element = new (buffer + count) T(std::forward<Args>(args)...);
+	++count;
+	return *element;
+}
+
+template <class T, size_t InlineN>
+template <class InputIt>
+void Stack<T, InlineN>::push_range(InputIt first, InputIt last)
+{
+	// Для прямых итераторов размер диапазона известен заранее, и буфер расширяется не более одного раза
+	typedef typename std::iterator_traits<InputIt>::iterator_category category;
+	if (std::is_base_of<std::forward_iterator_tag, category>::value)
+		reserve(count + static_cast<size_t>(std::distance(first, last)));
+	for (; first != last; ++first)
+		emplace(*first);
+}
+
+template <class T, size_t InlineN>
+T Stack<T, InlineN>::pop()
 {
 	assert(!empty());
-	return buffer[count-- - 1];
+	T* top = buffer + --count;
+	T value(std::move(*top));
+	top->~T();
+	return value;
+}
+
+template <class T, size_t InlineN>
+template <class OutputIt>
+OutputIt Stack<T, InlineN>::pop_into(OutputIt out, int items_count)
+{
+	assert(items_count >= 0 && items_count <= size());
+	for (int i = 0; i < items_count; ++i)
+	{
+		T* top = buffer + --count;
+		*out++ = std::move(*top);
+		top->~T();
+	}
+	return out;
 }
 
-int Stack::size() const
+template <class T, size_t InlineN>
+template <size_t OtherN>
+void Stack<T, InlineN>::pop_into(Stack<T, OtherN>& target)
 {
-	return count;
+	target.reserve(target.count + count);
+	T* destination = target.buffer + target.count;
+	while (count > 0)
+	{
+		T* top = buffer + --count;
+		new (destination++) T(std::move(*top));
+		top->~T();
+		++target.count;
+	}
+}
+
+template <class T, size_t InlineN>
+int Stack<T, InlineN>::size() const
+{
+	return static_cast<int>(count);
+}
+
+template <class T, size_t InlineN>
+bool Queue<T, InlineN>::empty() const
+{
+	return forward_stack.empty() && backward_stack.empty();
 }
 
-Queue::~Queue()
+template <class T, size_t InlineN>
+void Queue<T, InlineN>::push(const T& value)
 {
-	delete forward_stack;
-	delete backward_stack;
+	forward_stack.push(value);
 }
 
-bool Queue::empty() const
+template <class T, size_t InlineN>
+void Queue<T, InlineN>::push(T&& value)
 {
-	return forward_stack->empty() && backward_stack->empty();
+	forward_stack.push(std::move(value));
 }
 
-void Queue::push(int value)
+template <class T, size_t InlineN>
+template <class... Args>
+T& Queue<T, InlineN>::emplace(Args&&... args)
 {
-	forward_stack->push(value);
+	return forward_stack.emplace(std::forward<Args>(args)...);
 }
 
-int Queue::pop()
+template <class T, size_t InlineN>
+template <class InputIt>
+void Queue<T, InlineN>::push_range(InputIt first, InputIt last)
+{
+	forward_stack.push_range(first, last);
+}
+
+template <class T, size_t InlineN>
+T Queue<T, InlineN>::pop()
 {
 	assert(!empty());
-	if (backward_stack->empty())
-		while (!forward_stack->empty())
-			backward_stack->push(forward_stack->pop());
-	return backward_stack->pop();
+	if (backward_stack.empty())
+		forward_stack.pop_into(backward_stack);
+	return backward_stack.pop();
+}
+
+template <class T, size_t InlineN>
+template <class OutputIt>
+OutputIt Queue<T, InlineN>::pop_into(OutputIt out, int items_count)
+{
+	assert(items_count >= 0 && items_count <= size());
+	const int from_backward = std::min(items_count, backward_stack.size());
+	out = backward_stack.pop_into(out, from_backward);
+	items_count -= from_backward;
+	if (items_count > 0)
+	{
+		forward_stack.pop_into(backward_stack);
+		out = backward_stack.pop_into(out, items_count);
+	}
+	return out;
+}
+
+template <class T, size_t InlineN>
+int Queue<T, InlineN>::size() const
+{
+	return forward_stack.size() + backward_stack.size();
+}
+
+// Замер пропускной способности SpscQueue: один поток добавляет числа 0..count-1, другой извлекает и проверяет порядок
+int run_spsc_benchmark()
+{
+	const int count = 50000000;
+	SpscQueue queue(1 << 16);
+	bool order_ok = true;
+
+	const auto start_time = std::chrono::steady_clock::now();
+	std::thread consumer([&queue, &order_ok, count]()
+	{
+		for (int i = 0; i < count; ++i)
+			if (queue.pop() != i)
+				order_ok = false;
+	});
+	for (int i = 0; i < count; ++i)
+		queue.push(i);
+	consumer.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+	std::cout << "spsc: " << count << " ints in " << elapsed.count() << " s, "
+		<< count / elapsed.count() / 1e6 << " M ops/s, order " << (order_ok ? "OK" : "BROKEN") << "\n";
+	return order_ok ? 0 : 1;
+}
+
+// Замер задержки каждого pop: rounds раз добавляет depth элементов и затем извлекает их все.
+// Возвращает задержки в наносекундах
+template <class QueueType>
+std::vector<long long> measure_pop_latencies(int depth, int rounds)
+{
+	QueueType queue;
+	std::vector<long long> latencies;
+	latencies.reserve(static_cast<size_t>(depth) * rounds);
+	long long checksum = 0;
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (int i = 0; i < depth; ++i)
+			queue.push(i);
+		for (int i = 0; i < depth; ++i)
+		{
+			const auto start_time = std::chrono::steady_clock::now();
+			checksum += queue.pop();
+			const auto end_time = std::chrono::steady_clock::now();
+			latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+		}
+	}
+	if (checksum < 0)
+		std::cout << checksum; // Не даём компилятору выбросить извлечение
+	return latencies;
 }
 
-int Queue::size() const
+// Печатает перцентили и гистограмму задержек по корзинам [2^i, 2^(i+1)) нс
+void print_latency_histogram(const char* name, std::vector<long long>& latencies)
 {
-	return forward_stack->size() + backward_stack->size();
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&latencies](double p)
+	{
+		return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+	};
+	std::cout << name << ": p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99)
+		<< " ns, p99.9 " << percentile(0.999) << " ns, max " << latencies.back() << " ns\n";
+
+	std::vector<long long> buckets(64, 0);
+	for (const long long latency : latencies)
+	{
+		int bucket = 0;
+		while ((2LL << bucket) <= latency)
+			++bucket;
+		++buckets[bucket];
+	}
+	for (int i = 0; i < 64; ++i)
+		if (buckets[i] > 0)
+			std::cout << "  [" << (1LL << i) << ", " << (2LL << i) << ") ns: " << buckets[i] << "\n";
+}
+
+// Сравнение задержек pop очереди на двух стеках и очереди на блоках
+void run_latency_benchmark()
+{
+	const int depth = 1000000;
+	const int rounds = 5;
+	auto two_stack_latencies = measure_pop_latencies<Queue<int>>(depth, rounds);
+	print_latency_histogram("two-stack queue", two_stack_latencies);
+	auto block_latencies = measure_pop_latencies<BlockQueue<int>>(depth, rounds);
+	print_latency_histogram("block queue", block_latencies);
+}
+
+// Очередь на двух стеках под мьютексом - базовый вариант для сравнения с MpmcQueue
+class LockedQueue
+{
+public:
+	bool try_push(int value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push(value);
+		return true;
+	}
+
+	bool try_pop(int& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.empty())
+			return false;
+		value = queue.pop();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	Queue<int> queue;
+};
+
+// Добавляет в очередь все count элементов values, повторяя попытки, пока очередь заполнена
+template <bool batched, class QueueType>
+typename std::enable_if<batched>::type push_batch(QueueType& queue, const int* values, int count)
+{
+	size_t pushed = 0;
+	while (pushed < static_cast<size_t>(count))
+		pushed += queue.try_push_bulk(values + pushed, count - pushed);
+}
+
+template <bool batched, class QueueType>
+typename std::enable_if<!batched>::type push_batch(QueueType& queue, const int* values, int count)
+{
+	for (int i = 0; i < count; ++i)
+		while (!queue.try_push(values[i]))
+			std::this_thread::yield();
+}
+
+// Извлекает из очереди ровно count элементов в out, дожидаясь, пока их добавят другие потоки
+template <bool batched, class QueueType>
+typename std::enable_if<batched>::type pop_batch(QueueType& queue, int* out, int count)
+{
+	size_t popped = 0;
+	while (popped < static_cast<size_t>(count))
+	{
+		const size_t received = queue.try_pop_bulk(out + popped, count - popped);
+		if (received == 0)
+			std::this_thread::yield();
+		popped += received;
+	}
+}
+
+template <bool batched, class QueueType>
+typename std::enable_if<!batched>::type pop_batch(QueueType& queue, int* out, int count)
+{
+	for (int i = 0; i < count; ++i)
+		while (!queue.try_pop(out[i]))
+			std::this_thread::yield();
 }
 
-int main()
+// Каждый из threads_count потоков по очереди добавляет batch_size чисел и затем извлекает столько же.
+// Если batched, очередь используется через try_push_bulk/try_pop_bulk, иначе поэлементно.
+// Возвращает пропускную способность в миллионах элементов в секунду; checksum_ok сравнивает суммы добавленного и извлечённого
+template <class QueueType, bool batched>
+double measure_mpmc_throughput(int threads_count, int items_per_thread, bool& checksum_ok)
 {
-	int n = 0;
-	std::cin >> n;
+	const int batch_size = 32;
+	QueueType queue;
+	std::atomic<long long> pushed_sum{ 0 };
+	std::atomic<long long> popped_sum{ 0 };
 
-	Queue queue;
-	for (int i = 0; i < n; ++i)
+	const auto worker = [&](int thread_index)
 	{
-		int command = 0;
-		int value = 0;
-		std::cin >> command >> value;
-		switch (command)
+		int batch[batch_size];
+		long long local_pushed = 0;
+		long long local_popped = 0;
+		for (int done = 0; done < items_per_thread; done += batch_size)
+		{
+			for (int i = 0; i < batch_size; ++i)
+			{
+				batch[i] = thread_index * items_per_thread + done + i;
+				local_pushed += batch[i];
+			}
+			push_batch<batched>(queue, batch, batch_size);
+			pop_batch<batched>(queue, batch, batch_size);
+			for (int i = 0; i < batch_size; ++i)
+				local_popped += batch[i];
+		}
+		pushed_sum += local_pushed;
+		popped_sum += local_popped;
+	};
+
+	const auto start_time = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threads_count; ++i)
+		threads.emplace_back(worker, i);
+	for (auto& thread : threads)
+		thread.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+	checksum_ok = checksum_ok && pushed_sum == popped_sum;
+	return 2.0 * threads_count * items_per_thread / elapsed.count() / 1e6;
+}
+
+// Масштабирование MpmcQueue (поэлементно и пакетами) и очереди под мьютексом от 1 до N потоков
+int run_mpmc_benchmark()
+{
+	const int max_threads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+	const int items_per_thread = 1 << 20;
+	bool checksum_ok = true;
+	std::cout << "threads\tmutex queue\tmpmc\tmpmc bulk (M items/s)\n";
+	for (int threads_count = 1; threads_count <= max_threads; threads_count *= 2)
+	{
+		const double locked = measure_mpmc_throughput<LockedQueue, false>(threads_count, items_per_thread, checksum_ok);
+		const double single = measure_mpmc_throughput<MpmcQueue<int>, false>(threads_count, items_per_thread, checksum_ok);
+		const double bulk = measure_mpmc_throughput<MpmcQueue<int>, true>(threads_count, items_per_thread, checksum_ok);
+		std::cout << threads_count << "\t" << locked << "\t" << single << "\t" << bulk << "\n";
+	}
+	std::cout << "mpmc checksum " << (checksum_ok ? "OK" : "BROKEN") << "\n";
+	return checksum_ok ? 0 : 1;
+}
+
+// Выполняет count команд над очередью queue.
+// Возвращает 1, если все ожидания pop оправдались, 0 - если нет, и -1 при неизвестной команде
+template <class QueueType>
+int validate_commands(const Command* commands, size_t count, QueueType& queue)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const int value = commands[i].value;
+		switch (commands[i].command)
 		{
 		case 3:
 			queue.push(value);
@@ -128,21 +524,60 @@ int main()
 			if (queue.empty())
 			{
 				if (value != -1)
-				{
-					std::cout << "NO";
 					return 0;
-				}
 			}
 			else if (queue.pop() != value)
-			{
-				std::cout << "NO";
 				return 0;
-			}
 			break;
 		default:
 			return -1;
 		}
 	}
-	std::cout << "YES";
+	return 1;
+}
+
+// Читает команды из стандартного ввода, выполняет их над очередью queue и печатает YES или NO
+template <class QueueType>
+int process_commands(QueueType& queue)
+{
+	const MappedFile input(stdin);
+	CommandList commands;
+	if (!load_commands(input, commands))
+		return -1;
+
+	const int result = validate_commands(commands.data, commands.size, queue);
+	if (result < 0)
+		return -1;
+	std::cout << (result == 1 ? "YES" : "NO");
 	return 0;
 }
+
+// Без аргументов решает задачу очередью на двух стеках. Команды принимаются в текстовом или бинарном формате (CommandReader.h).
+// --block-queue решает её очередью на блоках, --to-binary переводит команды из stdin в бинарный формат, --benchmark запускает замеры
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--to-binary") == 0)
+	{
+		const MappedFile input(stdin);
+		CommandList commands;
+		if (!load_commands(input, commands))
+			return -1;
+		write_binary_commands(commands, stdout);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+	{
+		run_latency_benchmark();
+		const int spsc_result = run_spsc_benchmark();
+		const int mpmc_result = run_mpmc_benchmark();
+		return spsc_result != 0 ? spsc_result : mpmc_result;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--block-queue") == 0)
+	{
+		BlockQueue<int> queue;
+		return process_commands(queue);
+	}
+
+	Queue<int> queue;
+	return process_commands(queue);
+}
@@ -0,0 +1,172 @@
+﻿#pragma once
+
+#include "../common/CacheLine.h"
+#include <assert.h>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// D-арная куча. На вершине находится минимальный элемент в смысле Compare (при std::less - наименьший).
+// Элементы хранятся в массиве со сдвигом на D - 1 позицию: тогда первый потомок любого узла лежит
+// в позиции, кратной D, и все D братьев при D * sizeof(T) <= 64 попадают в одну кэш-линию.
+// Просеивание итеративное: вместо обменов элементы сдвигаются в «дырку», а просеиваемый записывается один раз в конце.
+template <class T, size_t D = 4, class Compare = std::less<T>>
+class DaryHeap
+{
+	static_assert(D >= 2, "Heap arity must be at least 2");
+
+public:
+	explicit DaryHeap(Compare compare = Compare());
+
+	// Заменяет содержимое кучи элементами диапазона [first, last) за O(n) (алгоритм Флойда)
+	template <class InputIt>
+	void heapify(InputIt first, InputIt last);
+
+	// Проверка на пустоту
+	bool empty() const;
+	// Количество элементов
+	int size() const;
+	// Минимальный элемент
+	const T& top() const;
+	// Добавление элемента
+	void push(const T& value);
+	void push(T&& value);
+	// Извлечение минимального элемента
+	T pop();
+	// Добавляет value и извлекает минимальный элемент за одно просеивание
+	T push_pop(T value);
+	// Извлекает минимальный элемент и добавляет value за одно просеивание. Куча не должна быть пустой
+	T replace_top(T value);
+
+private:
+	static constexpr size_t root = D - 1; // Позиция корня в массиве
+	std::vector<T, CacheAlignedAllocator<T>> array; // Первые D - 1 ячеек не используются
+	Compare compare;
+
+	static size_t first_child(size_t position) { return D * (position - root + 1); }
+	static size_t parent(size_t position) { return (position - root - 1) / D + root; }
+
+	// Поднимает value из позиции-«дырки» position
+	void sift_up(size_t position, T value);
+	// Спускает value из позиции-«дырки» position
+	void sift_down(size_t position, T value);
+};
+
+template <class T, size_t D, class Compare>
+DaryHeap<T, D, Compare>::DaryHeap(Compare compare) : array(root), compare(compare)
+{
+}
+
+template <class T, size_t D, class Compare>
+template <class InputIt>
+void DaryHeap<T, D, Compare>::heapify(InputIt first, InputIt last)
+{
+	array.resize(root);
+	array.insert(array.end(), first, last);
+	if (array.size() <= root + 1)
+		return;
+	// Просеиваем вниз все внутренние узлы, начиная с последнего
+	for (size_t position = parent(array.size() - 1) + 1; position-- > root;)
+		sift_down(position, std::move(array[position]));
+}
+
+template <class T, size_t D, class Compare>
+bool DaryHeap<T, D, Compare>::empty() const
+{
+	return array.size() == root;
+}
+
+template <class T, size_t D, class Compare>
+int DaryHeap<T, D, Compare>::size() const
+{
+	return static_cast<int>(array.size() - root);
+}
+
+template <class T, size_t D, class Compare>
+const T& DaryHeap<T, D, Compare>::top() const
+{
+	assert(!empty());
+	return array[root];
+}
+
+template <class T, size_t D, class Compare>
+void DaryHeap<T, D, Compare>::push(const T& value)
+{
+	push(T(value));
+}
+
+template <class T, size_t D, class Compare>
+void DaryHeap<T, D, Compare>::push(T&& value)
+{
+	array.emplace_back();
+	sift_up(array.size() - 1, std::move(value));
+}
+
+template <class T, size_t D, class Compare>
+T DaryHeap<T, D, Compare>::pop()
+{
+	assert(!empty());
+	T result = std::move(array[root]);
+	T last = std::move(array.back());
+	array.pop_back();
+	if (!empty())
+		sift_down(root, std::move(last));
+	return result;
+}
+
+template <class T, size_t D, class Compare>
+T DaryHeap<T, D, Compare>::push_pop(T value)
+{
+	if (empty() || !compare(array[root], value))
+		return value;
+	return replace_top(std::move(value));
+}
+
+template <class T, size_t D, class Compare>
+T DaryHeap<T, D, Compare>::replace_top(T value)
+{
+	assert(!empty());
+	T result = std::move(array[root]);
+	sift_down(root, std::move(value));
+	return result;
+}
+
+template <class T, size_t D, class Compare>
+void DaryHeap<T, D, Compare>::sift_up(size_t position, T value)
+{
+	while (position > root)
+	{
+		const size_t parent_position = parent(position);
+		if (!compare(value, array[parent_position]))
+			break;
+		array[position] = std::move(array[parent_position]);
+		position = parent_position;
+	}
+	array[position] = std::move(value);
+}
+
+template <class T, size_t D, class Compare>
+void DaryHeap<T, D, Compare>::sift_down(size_t position, T value)
+{
+	const size_t end = array.size();
+	while (true)
+	{
+		const size_t first = first_child(position);
+		if (first >= end)
+			break;
+		// Находим наименьшего из потомков
+		const size_t last = std::min(first + D, end);
+		size_t best = first;
+		for (size_t child = first + 1; child < last; ++child)
+			if (compare(array[child], array[best]))
+				best = child;
+		if (!compare(array[best], value))
+			break;
+		array[position] = std::move(array[best]);
+		position = best;
+	}
+	array[position] = std::move(value);
+}
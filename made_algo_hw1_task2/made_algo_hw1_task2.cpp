@@ -7,123 +7,160 @@
 // Требуется написать программу, которая определяет минимальное время, достаточное для вычисления суммы заданного набора чисел.
 //
 
-#include <assert.h>
+#include "../common/Parallel.h"
+#include "../common/RadixSort.h"
+#include "DaryHeap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
-// Куча, в которой каждый узел не превосходит её потомков
-class MinHeap
-{
-public:
-	// Проверка на пустоту
-	bool empty() const;
-	// Добавление элемента
-	void push(int value);
-	// Извлечение минимального элемента
-	int pop();
-	// Количество элементов
-	int size() const;
-
-private:
-	std::vector<int> array;
-
-	// поднимает элемент, который меньше родительского
-	void sift_up(int i);
-	// спускает элемент, который больше дочерних
-	void sift_down(int i);
-};
-
-bool MinHeap::empty() const
-{
-	return array.empty();
-}
+// Количество операций не помещается в int уже для сотни тысяч чисел порядка 10^9.
+// Для n <= 10^8 чисел из [0, 10^9] оно не превосходит n * 10^9 * log2(n) < 2^63
+typedef long long operations_count;
 
-void MinHeap::push(int value)
+// Возвращает минимальное количество операций, необходимое для сложения чисел в куче
+// Два наименьших числа заменяются суммой: одно извлечение и одно просеивание вместо pop-pop-push
+template <size_t D>
+operations_count get_min_operations(DaryHeap<long long, D>& heap)
 {
-	array.push_back(value);
-	sift_up(size() - 1);
+	operations_count operations = 0;
+	while (heap.size() > 1)
+	{
+		long long first_number = heap.pop();
+		long long sum = first_number + heap.top();
+		operations += sum;
+		heap.replace_top(sum);
+	}
+	return operations;
 }
 
-int MinHeap::pop()
+// Возвращает минимальное количество операций для неотрицательных чисел values за O(n) после сортировки.
+// Суммы, получаемые жадным алгоритмом, не убывают, поэтому вместо кучи хватает двух очередей:
+// отсортированных исходных чисел и сумм в порядке их появления. Очередной минимум - меньшая из голов очередей.
+// Массив values сортируется поразрядной сортировкой в threads_count потоков
+operations_count get_min_operations_two_queues(std::vector<int>& values, unsigned threads_count)
 {
-	assert(!empty());
-	int result = array[0];
-	array[0] = array.back();
-	array.pop_back();
-	if (size() > 0)
-		sift_down(0);
-	return result;
+	if (values.size() < 2)
+		return 0;
+	radix_sort(values.data(), values.size(), threads_count);
+
+	std::vector<operations_count> sums(values.size() - 1);
+	size_t values_head = 0;
+	size_t sums_head = 0;
+	size_t sums_tail = 0;
+	const auto take_min = [&]()
+	{
+		if (sums_head == sums_tail ||
+			(values_head < values.size() && static_cast<operations_count>(values[values_head]) <= sums[sums_head]))
+			return static_cast<operations_count>(values[values_head++]);
+		return sums[sums_head++];
+	};
+
+	operations_count operations = 0;
+	for (size_t i = 0; i + 1 < values.size(); ++i)
+	{
+		const operations_count first_number = take_min();
+		const operations_count sum = first_number + take_min();
+		operations += sum;
+		sums[sums_tail++] = sum;
+	}
+	return operations;
 }
 
-int MinHeap::size() const
+// Возвращает минимальное количество операций: для неотрицательных чисел - двумя очередями, иначе кучей.
+// Массив values может быть переупорядочен
+operations_count solve(std::vector<int>& values, bool force_heap)
 {
-	return array.size();
+	const bool has_negative = std::any_of(values.begin(), values.end(), [](int value) { return value < 0; });
+	if (!force_heap && !has_negative)
+		return get_min_operations_two_queues(values, parallel::default_threads_count());
+	DaryHeap<long long, 4> heap;
+	heap.heapify(values.begin(), values.end());
+	return get_min_operations(heap);
 }
 
-void MinHeap::sift_up(int i)
+// Сравнение времени работы кучи и двух очередей на случайных числах из [0, 10^9] для n от 10^6 до max_n
+int run_benchmark(long long max_n)
 {
-	assert(i >= 0 && i < size());
-	if (i == 0) return;
-	int parent_index = (i - 1) / 2;
-	if (array[i] < array[parent_index])
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<int> distribution(0, 1000000000);
+	bool results_match = true;
+	std::cout << "n\theap ns/element\ttwo queues ns/element\n";
+	for (long long n = 1000000; n <= max_n; n *= 10)
 	{
-		std::swap(array[i], array[parent_index]);
-		sift_up(parent_index);
+		std::vector<int> values(static_cast<size_t>(n));
+		for (auto& value : values)
+			value = distribution(generator);
+		std::vector<int> values_copy = values;
+
+		auto start_time = std::chrono::steady_clock::now();
+		const operations_count heap_result = solve(values, true);
+		const std::chrono::duration<double, std::nano> heap_time = std::chrono::steady_clock::now() - start_time;
+
+		start_time = std::chrono::steady_clock::now();
+		const operations_count queues_result = solve(values_copy, false);
+		const std::chrono::duration<double, std::nano> queues_time = std::chrono::steady_clock::now() - start_time;
+
+		results_match = results_match && heap_result == queues_result;
+		std::cout << n << "\t" << heap_time.count() / n << "\t" << queues_time.count() / n << "\n";
 	}
+	std::cout << "results " << (results_match ? "match" : "DIFFER") << "\n";
+	return results_match ? 0 : 1;
 }
 
-void MinHeap::sift_down(int i)
+// Пропускная способность radix_sort на случайных 32- и 64-битных ключах в одном потоке и во всех потоках
+template <class Key>
+void run_radix_benchmark(size_t n)
 {
-	assert(i >= 0 && i < size());
-	if (i >= size() / 2 || size() == 1) return; // Листовые узлы просеивать некуда
-	int left_child_index = 2 * i + 1; // Благодаря проверке выше существует всегда
-	int right_child_index = 2 * i + 2; // Может отсутствовать!
-	bool has_right_child = right_child_index != size();
-	// Если узел не превосходит своих потомков, то просеивать ничего не нужно
-	if (array[i] <= array[left_child_index] &&
-		(!has_right_child || array[i] <= array[right_child_index]))
-		return;
-	// Иначе меняем узел с наименьшим из потомков
-	if (!has_right_child || array[left_child_index] <= array[right_child_index])
-	{
-		std::swap(array[i], array[left_child_index]);
-		sift_down(left_child_index);
-	}
-	else
+	std::mt19937_64 generator(42);
+	std::vector<Key> original(n);
+	for (auto& value : original)
+		value = static_cast<Key>(generator());
+
+	const unsigned max_threads = parallel::default_threads_count();
+	for (const unsigned threads_count : { 1u, max_threads })
 	{
-		std::swap(array[i], array[right_child_index]);
-		sift_down(right_child_index);
+		std::vector<Key> values = original;
+		const auto start_time = std::chrono::steady_clock::now();
+		radix_sort(values.data(), values.size(), threads_count);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+		const bool sorted = std::is_sorted(values.begin(), values.end());
+		std::cout << sizeof(Key) * 8 << "-bit keys, " << threads_count << " threads: "
+			<< n * sizeof(Key) / elapsed.count() / 1e9 << " GB/s" << (sorted ? "" : " NOT SORTED") << "\n";
 	}
 }
 
-// Возвращает минимальное количество операций, необходимое для сложения чисел в куче
-int get_min_operations(MinHeap& heap)
+// --heap решает задачу кучей даже для неотрицательных чисел, --benchmark [max_n] сравнивает оба способа,
+// --radix-benchmark [n] замеряет поразрядную сортировку
+int main(int argc, char* argv[])
 {
-	int operations = 0;
-	while (heap.size() > 1)
+	if (argc > 1 && std::strcmp(argv[1], "--radix-benchmark") == 0)
 	{
-		int first_number = heap.pop();
-		int second_number = heap.pop();
-		int sum = first_number + second_number;
-		operations += sum;
-		heap.push(sum);
+		const size_t n = argc > 2 ? std::stoull(argv[2]) : 100000000ULL;
+		run_radix_benchmark<int32_t>(n);
+		run_radix_benchmark<int64_t>(n);
+		return 0;
 	}
-	return operations;
-}
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+		return run_benchmark(argc > 2 ? std::stoll(argv[2]) : 100000000LL);
+	const bool force_heap = argc > 1 && std::strcmp(argv[1], "--heap") == 0;
+
+	std::ios_base::sync_with_stdio(false);
+	std::cin.tie(nullptr);
 
-int main()
-{
 	int n = 0;
 	std::cin >> n;
 
-	MinHeap heap;
-
+	std::vector<int> values(n);
 	for (int i = 0; i < n; ++i)
-	{
-		int value = 0;
-		std::cin >> value;
-		heap.push(value);
-	}
-	std::cout << get_min_operations(heap);
+		std::cin >> values[i];
+
+	std::cout << solve(values, force_heap);
 	return 0;
 }
@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include "../common/CpuFeatures.h"
+#include <algorithm>
+
+#if CPU_X86 && defined(_MSC_VER)
+#define NETWORK_TARGET_AVX2
+#elif CPU_X86
+#define NETWORK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Битонная сортирующая сеть на 16 целых чисел: 10 слоёв сравнений-обменов, не зависящих от данных.
+// В sort_avx2 числа лежат в двух 256-битных регистрах, и слой сети - это перестановка, min, max и смешивание по маске.
+// sort_scalar выполняет ту же сеть над массивом. Векторный вариант компилируется для любого процессора x86,
+// а выбирается во время выполнения (fastest_sort), только если процессор поддерживает AVX2
+namespace network
+{
+	constexpr int size = 16;
+
+	// Функция, сортирующая по возрастанию network::size чисел массива
+	typedef void (*sort_function)(int* values);
+
+	// Сортирует по возрастанию 16 чисел массива values
+	inline void sort_scalar(int* values)
+	{
+		for (int block = 2; block <= size; block *= 2)
+		{
+			for (int distance = block / 2; distance > 0; distance /= 2)
+			{
+				for (int i = 0; i < size; ++i)
+				{
+					if ((i & distance) != 0)
+						continue;
+					const int j = i | distance;
+					const int low = std::min(values[i], values[j]);
+					const int high = std::max(values[i], values[j]);
+					const bool ascending = (i & block) == 0;
+					values[i] = ascending ? low : high;
+					values[j] = ascending ? high : low;
+				}
+			}
+		}
+	}
+
+#if CPU_X86
+	// Маска смешивания для слоя с расстоянием distance внутри битонных блоков длины block:
+	// бит i установлен, если позиция offset + i получает больший из пары
+	constexpr int blend_mask(int distance, int block, int offset)
+	{
+		int mask = 0;
+		for (int i = 0; i < 8; ++i)
+			if (((i & distance) != 0) != (((offset + i) & block) != 0))
+				mask |= 1 << i;
+		return mask;
+	}
+
+	// Пара каждого элемента на расстоянии distance
+	template <int distance>
+	NETWORK_TARGET_AVX2 __m256i partner(__m256i values);
+
+	template <>
+	NETWORK_TARGET_AVX2 inline __m256i partner<1>(__m256i values)
+	{
+		return _mm256_shuffle_epi32(values, 0xB1);
+	}
+
+	template <>
+	NETWORK_TARGET_AVX2 inline __m256i partner<2>(__m256i values)
+	{
+		return _mm256_shuffle_epi32(values, 0x4E);
+	}
+
+	template <>
+	NETWORK_TARGET_AVX2 inline __m256i partner<4>(__m256i values)
+	{
+		return _mm256_permute2x128_si256(values, values, 0x01);
+	}
+
+	// Слой сети внутри одного регистра, содержащего позиции [offset, offset + 8)
+	template <int distance, int block, int offset>
+	NETWORK_TARGET_AVX2 __m256i compare_exchange(__m256i values)
+	{
+		const __m256i other = partner<distance>(values);
+		return _mm256_blend_epi32(_mm256_min_epi32(values, other), _mm256_max_epi32(values, other),
+			blend_mask(distance, block, offset));
+	}
+
+	// Первые шесть слоёв: регистр с offset = 0 сортируется по возрастанию, с offset = 8 - по убыванию
+	template <int offset>
+	NETWORK_TARGET_AVX2 __m256i sort_register(__m256i values)
+	{
+		values = compare_exchange<1, 2, offset>(values);
+		values = compare_exchange<2, 4, offset>(values);
+		values = compare_exchange<1, 4, offset>(values);
+		values = compare_exchange<4, 8, offset>(values);
+		values = compare_exchange<2, 8, offset>(values);
+		return compare_exchange<1, 8, offset>(values);
+	}
+
+	// Последние три слоя слияния: упорядочивают битонную последовательность внутри регистра
+	NETWORK_TARGET_AVX2 inline __m256i merge_register(__m256i values)
+	{
+		values = compare_exchange<4, 16, 0>(values);
+		values = compare_exchange<2, 16, 0>(values);
+		return compare_exchange<1, 16, 0>(values);
+	}
+
+	// Сортирует по возрастанию 16 чисел массива values
+	NETWORK_TARGET_AVX2 inline void sort_avx2(int* values)
+	{
+		const __m256i low = sort_register<0>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)));
+		const __m256i high = sort_register<8>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + 8)));
+		// Слой с расстоянием 8 сравнивает регистры поэлементно
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(values), merge_register(_mm256_min_epi32(low, high)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(values + 8), merge_register(_mm256_max_epi32(low, high)));
+	}
+#endif
+
+	// Есть ли векторный вариант сети на этом процессоре
+	inline bool vectorized()
+	{
+		return cpu::supports_avx2();
+	}
+
+	// Самый быстрый вариант сети, доступный на этом процессоре. Определяется один раз
+	inline sort_function fastest_sort()
+	{
+#if CPU_X86
+		static const sort_function fastest = vectorized() ? sort_avx2 : sort_scalar;
+		return fastest;
+#else
+		return sort_scalar;
+#endif
+	}
+}
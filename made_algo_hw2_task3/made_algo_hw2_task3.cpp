@@ -4,14 +4,21 @@
 // Последовательность может быть очень длинной. Время работы O(n * log(k)). Память O(k). Использовать слияние.
 //
 
+#include "../common/Parallel.h"
+#include "../common/RadixSort.h"
+#include "../common/StreamIO.h"
+#include "SortingNetwork.h"
 #include <iostream>
 #include <algorithm>
-
-// Целочисленное деление с округлением вверх
-int ceil_division(int x, int y)
-{
-	return (x + y - 1) / y;
-}
+#include <chrono>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Сливает два отсортированных подмассива
 void merge(int* first, int firstLen, int* second, int secondLen, int* result)
@@ -32,67 +39,514 @@ void merge(int* first, int firstLen, int* second, int secondLen, int* result)
 		result[k++] = second[j++];
 }
 
-// Рекурсивная сортировка слиянием
-void merge_sort(int* start, int n)
+// Подмассивы не длиннее этого сортируются вставками
+constexpr int insertion_sort_cutoff = 16;
+
+// Сортировка вставками для коротких подмассивов
+void insertion_sort(int* start, int n)
 {
-	if (n <= 1)
+	for (int i = 1; i < n; ++i)
+	{
+		const int value = start[i];
+		int j = i;
+		for (; j > 0 && start[j - 1] > value; --j)
+			start[j] = start[j - 1];
+		start[j] = value;
+	}
+}
+
+// Рекурсивная сортировка слиянием. buffer - вспомогательный массив не меньше чем из n элементов
+void merge_sort(int* start, int n, int* buffer)
+{
+	if (n <= insertion_sort_cutoff)
+	{
+		insertion_sort(start, n);
 		return;
+	}
 	int mid = n / 2;
 	int* left_start = start;
 	int left_len = mid;
 	int* right_start = start + left_len;
 	int right_len = n - mid;
-	merge_sort(left_start, left_len);
-	merge_sort(right_start, right_len);
-	int* sorted = new int[n];
-	merge(left_start, left_len, right_start, right_len, sorted);
-	std::copy(sorted, sorted + n, start);
-	delete[] sorted;
+	merge_sort(left_start, left_len, buffer);
+	merge_sort(right_start, right_len, buffer);
+	if (left_start[left_len - 1] <= right_start[0]) // Половины уже упорядочены друг относительно друга
+		return;
+	merge(left_start, left_len, right_start, right_len, buffer);
+	std::copy(buffer, buffer + n, start);
+}
+
+// Сортировка подмассива поразрядной сортировкой - альтернатива merge_sort для больших k
+void radix_sort_block(int* start, int n, int* buffer)
+{
+	radix_sort(start, static_cast<size_t>(n), buffer);
+}
+
+// Функция сортировки подмассива длины n с вспомогательным буфером не меньше чем из n элементов
+typedef void (*block_sorter)(int* start, int n, int* buffer);
+
+// Вспомогательный буфер сортировки, который можно переиспользовать между вызовами.
+// Память выделяется, только когда текущей ёмкости не хватает, и каждое выделение подсчитывается
+class ScratchBuffer
+{
+public:
+	// Буфер не меньше чем из size элементов
+	int* get(size_t size);
+	// Сколько раз буфер выделял память
+	long long allocations() const { return allocations_count; }
+
+private:
+	std::vector<int> storage;
+	long long allocations_count = 0;
+};
+
+int* ScratchBuffer::get(size_t size)
+{
+	if (storage.size() < size)
+	{
+		storage.resize(size);
+		++allocations_count;
+	}
+	return storage.data();
 }
 
 // Последовательно движется слева направо, сортирует пары соседних подмассивов длины k и сливает их
-void sort(int* values, int n, int k)
+// Подмассивы сортируются функцией sort_block. Все шаги используют один вспомогательный буфер размера 2k из scratch
+void sort(int* values, size_t n, int k, ScratchBuffer& scratch, block_sorter sort_block = merge_sort)
 {
-	int subarrays_count = ceil_division(n, k);
-	for (int i = 0; i < subarrays_count - 1; ++i)
+	if (n <= 1)
+		return;
+	k = static_cast<int>(std::max<size_t>(1, std::min<size_t>(k, n)));
+	int* buffer = scratch.get(2 * static_cast<size_t>(k));
+	sort_block(values, k, buffer);
+	for (size_t left = 0; n - left > static_cast<size_t>(k); left += k)
 	{
-		int* left_start = values + i * k;
+		int* left_start = values + left;
 		int* right_start = left_start + k;
-		if (i == 0)
-			merge_sort(left_start, k);
-		int right_len = std::min(k, n - (i + 1) * k);
-		merge_sort(right_start, right_len);
-		int* merged = new int[k + right_len];
-		merge(left_start, k, right_start, right_len, merged);
-		for (int j = 0; j < k + right_len; ++j)
-			left_start[j] = merged[j];
-		delete[] merged;
-	}
-}
-
-int main()
-{
-	std::ios_base::sync_with_stdio(false);
-	std::cin.tie(nullptr);
-	
-	int n = 0;
-	std::cin >> n;
-	
-	int k = 0;
-	std::cin >> k;
+		int right_len = static_cast<int>(std::min<size_t>(k, n - left - k));
+		sort_block(right_start, right_len, buffer);
+		if (left_start[k - 1] <= right_start[0])
+			continue;
+		merge(left_start, k, right_start, right_len, buffer);
+		std::copy(buffer, buffer + k + right_len, left_start);
+	}
+}
+
+void sort(int* values, size_t n, int k, block_sorter sort_block = merge_sort)
+{
+	ScratchBuffer scratch;
+	sort(values, n, k, scratch, sort_block);
+}
+
+constexpr size_t min_stripe_size = 1 << 16; // Более короткие полосы не окупают запуск потока
+
+// Начало полосы index при делении n чисел на stripes_count почти равных полос
+inline size_t stripe_begin(size_t n, unsigned stripes_count, unsigned index)
+{
+	return n * index / stripes_count;
+}
+
+// Сортирует массив в threads_count потоков. Массив делится на полосы длины не меньше 2k, каждая сортируется отдельно.
+// Полоса сама удовлетворяет условию задачи, а из левой полосы правее границы могут уйти только числа с последних k - 1 позиций:
+// все остальные не больше любого числа правой полосы. Поэтому после сортировки полос достаточно слить
+// по k - 1 числу с каждой стороны каждой границы, и эти слияния тоже независимы
+void sort(int* values, size_t n, int k, unsigned threads_count, block_sorter sort_block = merge_sort)
+{
+	k = static_cast<int>(std::max<size_t>(1, std::min<size_t>(k, n)));
+	const size_t min_stripe = std::max<size_t>(2 * static_cast<size_t>(k), min_stripe_size);
+	const unsigned stripes_count = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads_count, n / min_stripe)));
+	if (stripes_count == 1)
+	{
+		sort(values, n, k, sort_block);
+		return;
+	}
+	parallel::for_each_index(stripes_count, [values, n, k, stripes_count, sort_block](unsigned stripe)
+	{
+		const size_t begin = stripe_begin(n, stripes_count, stripe);
+		sort(values + begin, stripe_begin(n, stripes_count, stripe + 1) - begin, k, sort_block);
+	});
+	if (k == 1)
+		return;
+	const int side = k - 1;
+	parallel::for_each_index(stripes_count - 1, [values, n, side, stripes_count](unsigned boundary_index)
+	{
+		const size_t boundary = stripe_begin(n, stripes_count, boundary_index + 1);
+		int* left_start = values + boundary - side;
+		int* right_start = values + boundary;
+		if (left_start[side - 1] <= right_start[0])
+			return;
+		std::vector<int> buffer(2 * static_cast<size_t>(side));
+		merge(left_start, side, right_start, side, buffer.data());
+		std::copy(buffer.begin(), buffer.end(), left_start);
+	});
+}
+
+// Число с итоговой позицией i стоит в исходной последовательности не дальше позиции i + k - 1.
+// Поэтому окно из network::size чисел, начинающееся после уже расставленных, определяет следующие network::size - k из них.
+// Окно сортируется сетью на месте и сдвигается на network::size - k позиций, память O(1).
+// При k >= network::size окно ничего не определяет, и массив сортируется слиянием подмассивов
+void sort_with_network(int* values, int n, int k)
+{
+	if (k >= network::size)
+	{
+		sort(values, n, k);
+		return;
+	}
+	const network::sort_function sort_window = network::fastest_sort();
+	const int step = network::size - std::max(1, k);
+	int start = 0;
+	for (; n - start > network::size; start += step)
+		sort_window(values + start);
+	// Последнее окно дополняется максимальными значениями до размера сети
+	int tail[network::size];
+	const int tail_len = std::max(0, n - start);
+	std::copy(values + start, values + start + tail_len, tail);
+	std::fill(tail + tail_len, tail + network::size, INT_MAX);
+	sort_window(tail);
+	std::copy(tail, tail + tail_len, values + start);
+}
+
+// Спускает value из позиции-«дырки» position двоичной кучи heap из size элементов с минимумом на вершине
+void sift_down(int* heap, int size, int position, int value)
+{
+	while (true)
+	{
+		int child = 2 * position + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && heap[child + 1] < heap[child])
+			++child;
+		if (value <= heap[child])
+			break;
+		heap[position] = heap[child];
+		position = child;
+	}
+	heap[position] = value;
+}
+
+// Куча из k чисел скользит по массиву: вместе с очередным числом в ней находятся k + 1 кандидатов,
+// среди которых обязательно есть следующее по порядку число. Оно записывается на уже прочитанную позицию. Время O(n * log(k))
+void sort_with_heap(int* values, int n, int k)
+{
+	if (n <= 1)
+		return;
+	k = std::max(1, std::min(k, n));
+	int* heap = new int[k];
+	std::copy(values, values + k, heap);
+	for (int position = k / 2; position-- > 0;)
+		sift_down(heap, k, position, heap[position]);
+	for (int i = k; i < n; ++i)
+	{
+		const int value = values[i];
+		if (value <= heap[0]) // Новое число не больше всех в куче - оно и есть следующее
+		{
+			values[i - k] = value;
+			continue;
+		}
+		values[i - k] = heap[0];
+		sift_down(heap, k, 0, value);
+	}
+	for (int size = k; size > 0; --size)
+	{
+		values[n - size] = heap[0];
+		sift_down(heap, size - 1, 0, heap[size - 1]);
+	}
+	delete[] heap;
+}
+
+// Границы выбора способа в sort_adaptive, подобранные по run_crossover_benchmark.
+// Сеть выгодна только в векторном варианте: скалярная медленнее слияния уже при k = 1.
+// Скользящая куча при любом k проигрывает слиянию из-за непредсказуемых ветвлений при просеивании
+inline int network_max_k()
+{
+	return network::vectorized() ? 12 : 0;
+}
+
+constexpr int radix_min_k = 2 * static_cast<int>(radix::small_array_size); // Меньшие подмассивы radix_sort сортирует std::sort
+
+// Выбирает самый быстрый для данного k способ: сортирующую сеть, слияние подмассивов или слияние с поразрядной сортировкой
+void sort_adaptive(int* values, int n, int k)
+{
+	if (k <= network_max_k())
+		sort_with_network(values, n, k);
+	else if (k >= radix_min_k)
+		sort(values, n, k, radix_sort_block);
+	else
+		sort(values, n, k);
+}
+
+// Сортирует последовательность из n чисел, читая её из reader и выводя в writer по мере готовности.
+// В памяти находится только окно из двух подмассивов длины k и буфер для их слияния - O(k) независимо от n.
+// После слияния окна его первые k чисел не превосходят всех ещё не прочитанных и выводятся сразу
+void sort_stream(IntegerReader& reader, long long n, int k, BufferedWriter& writer, block_sorter sort_block = merge_sort)
+{
+	if (n <= 0)
+		return;
+	k = static_cast<int>(std::max(1LL, std::min<long long>(k, n)));
+	std::vector<int> window(2 * static_cast<size_t>(k));
+	std::vector<int> buffer(2 * static_cast<size_t>(k));
+	long long remaining = n;
+
+	// Читает до count чисел в destination и возвращает, сколько удалось прочитать
+	const auto read_block = [&reader, &remaining](int* destination, int count)
+	{
+		int read = 0;
+		long long value = 0;
+		while (read < count && reader.next(value))
+			destination[read++] = static_cast<int>(value);
+		remaining = read < count ? 0 : remaining - read;
+		return read;
+	};
+
+	int left_len = read_block(window.data(), static_cast<int>(std::min<long long>(k, remaining)));
+	sort_block(window.data(), left_len, buffer.data());
+	while (remaining > 0)
+	{
+		int* right_start = window.data() + left_len;
+		const int right_len = read_block(right_start, static_cast<int>(std::min<long long>(k, remaining)));
+		sort_block(right_start, right_len, buffer.data());
+		merge(window.data(), left_len, right_start, right_len, buffer.data());
+		for (int i = 0; i < left_len; ++i)
+			writer.write(buffer[i]);
+		std::copy(buffer.begin() + left_len, buffer.begin() + left_len + right_len, window.begin());
+		left_len = right_len;
+	}
+	for (int i = 0; i < left_len; ++i)
+		writer.write(window[i]);
+}
+
+// Потоковый вариант sort_with_network: в памяти только окно сети. После сортировки окна его первые network::size - k чисел
+// выводятся, остальные k сдвигаются в начало, а освободившееся место дочитывается. Требует k < network::size
+void sort_stream_with_network(IntegerReader& reader, long long n, int k, BufferedWriter& writer)
+{
+	const network::sort_function sort_window = network::fastest_sort();
+	const int step = network::size - std::max(1, k);
+	int window[network::size];
+	int filled = 0;
+	long long remaining = n;
+	while (true)
+	{
+		long long value = 0;
+		while (filled < network::size && remaining > 0)
+		{
+			if (!reader.next(value))
+			{
+				remaining = 0;
+				break;
+			}
+			window[filled++] = static_cast<int>(value);
+			--remaining;
+		}
+		if (filled < network::size || remaining == 0)
+			break;
+		sort_window(window);
+		for (int i = 0; i < step; ++i)
+			writer.write(window[i]);
+		std::copy(window + step, window + network::size, window);
+		filled = network::size - step;
+	}
+	// Последнее окно дополняется максимальными значениями до размера сети
+	std::fill(window + filled, window + network::size, INT_MAX);
+	sort_window(window);
+	for (int i = 0; i < filled; ++i)
+		writer.write(window[i]);
+}
 
-	int* values = new int[n];
-	
+// Потоковый вариант sort_adaptive: способ выбирается по k по тем же границам
+void sort_stream_adaptive(IntegerReader& reader, long long n, int k, BufferedWriter& writer)
+{
+	if (k <= network_max_k())
+		sort_stream_with_network(reader, n, k, writer);
+	else
+		sort_stream(reader, n, k, writer, k >= radix_min_k ? radix_sort_block : merge_sort);
+}
+
+// Время на элемент для сортировки n чисел при разных k и общее число выделений памяти вспомогательным буфером.
+// Каждый способ использует один ScratchBuffer во всех замерах. k перебираются по убыванию, поэтому буфер выделяется
+// в первом замере, а дальше только переиспользуется: число выделений должно оставаться равным 1.
+// Последовательность получается перемешиванием отсортированного массива внутри блоков длины k
+void run_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> sorted(n);
 	for (int i = 0; i < n; ++i)
-		std::cin >> values[i];
+		sorted[i] = i;
 
-	sort(values, n, k);
+	int max_k = 1;
+	while (max_k * 8 <= n && max_k * 8 <= (1 << 20))
+		max_k *= 8;
+	const block_sorter sorters[] = { merge_sort, radix_sort_block };
+	ScratchBuffer scratches[2];
+	std::cout << "k\tmerge ns/element\tmerge scratch allocations (total)\tradix ns/element\tradix scratch allocations (total)\n";
+	for (int k = max_k; k >= 1 && k <= n; k /= 8)
+	{
+		std::vector<int> values = sorted;
+		for (int start = 0; start < n; start += k)
+			std::shuffle(values.begin() + start, values.begin() + std::min(n, start + k), generator);
+		std::cout << k;
+		for (int i = 0; i < 2; ++i)
+		{
+			std::vector<int> copy = values;
+			const auto start_time = std::chrono::steady_clock::now();
+			sort(copy.data(), n, k, scratches[i], sorters[i]);
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start_time;
+			std::cout << "\t" << elapsed.count() / n << "\t" << scratches[i].allocations()
+				<< (copy == sorted ? "" : " NOT SORTED");
+		}
+		std::cout << "\n";
+	}
+}
 
+// Время на элемент для каждого способа сортировки n чисел при k = 1, 2, 4, ... - по нему выбираются границы в sort_adaptive.
+// Сортирующая сеть применима только при k < network::size
+void run_crossover_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> sorted(n);
 	for (int i = 0; i < n; ++i)
-		std::cout << values[i] << " ";
+		sorted[i] = i;
 
-	std::cout.flush();
-	delete[] values;
-	return 0;
+	typedef void (*sorter)(int* values, int n, int k);
+	const sorter sorters[] = {
+		sort_with_network,
+		sort_with_heap,
+		[](int* values, int n, int k) { sort(values, n, k); },
+		[](int* values, int n, int k) { sort(values, n, k, radix_sort_block); },
+		sort_adaptive,
+	};
+	std::cout << "k\tnetwork\theap\tmerge\tradix\tadaptive (ns/element)\n";
+	for (int k = 1; k <= n && k <= (1 << 16); k *= 2)
+	{
+		std::vector<int> values = sorted;
+		for (int start = 0; start < n; start += k)
+			std::shuffle(values.begin() + start, values.begin() + std::min(n, start + k), generator);
+		std::cout << k;
+		for (const sorter sort_values : sorters)
+		{
+			if (sort_values == sorters[0] && k >= network::size)
+			{
+				std::cout << "\t-";
+				continue;
+			}
+			std::vector<int> copy = values;
+			const auto start_time = std::chrono::steady_clock::now();
+			sort_values(copy.data(), n, k);
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start_time;
+			std::cout << "\t" << elapsed.count() / n << (copy == sorted ? "" : " NOT SORTED");
+		}
+		std::cout << "\n";
+	}
+}
+
+// Время на элемент и ускорение параллельной сортировки n чисел с заданным k при 1, 2, 4, ... потоках
+void run_parallel_benchmark(size_t n, int k)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (size_t i = 0; i < n; ++i)
+		values[i] = static_cast<int>(i);
+	for (size_t start = 0; start < n; start += k)
+		std::shuffle(values.begin() + start, values.begin() + std::min(n, start + k), generator);
+
+	const unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+	double single_thread_time = 0;
+	std::cout << "threads\tns/element\tspeedup\n";
+	for (unsigned threads_count = 1; threads_count <= max_threads; threads_count *= 2)
+	{
+		std::vector<int> copy = values;
+		const auto start_time = std::chrono::steady_clock::now();
+		sort(copy.data(), n, k, threads_count);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+		if (threads_count == 1)
+			single_thread_time = elapsed.count();
+		std::cout << threads_count << "\t" << elapsed.count() * 1e9 / n << "\t" << single_thread_time / elapsed.count()
+			<< (std::is_sorted(copy.begin(), copy.end()) ? "" : " NOT SORTED") << "\n";
+	}
 }
 
+// Читает n, k и последовательность из reader и выводит её отсортированной. При threads_count > 0 последовательность
+// читается целиком (память O(n)) и сортируется параллельно в threads_count потоков, иначе - потоково с памятью O(k)
+void sort_input(IntegerReader& reader, bool use_radix, unsigned threads_count)
+{
+	long long n = 0;
+	long long k = 0;
+	reader.next(n);
+	reader.next(k);
+
+	BufferedWriter writer(stdout);
+	if (n <= 0)
+		return;
+	k = std::max(1LL, std::min(k, n));
+	if (threads_count > 0)
+	{
+		std::vector<int> values;
+		values.reserve(static_cast<size_t>(n));
+		long long value = 0;
+		while (static_cast<long long>(values.size()) < n && reader.next(value))
+			values.push_back(static_cast<int>(value));
+		sort(values.data(), values.size(), static_cast<int>(k), threads_count,
+			use_radix || k >= radix_min_k ? radix_sort_block : merge_sort);
+		for (const int sorted_value : values)
+			writer.write(sorted_value);
+		return;
+	}
+	if (use_radix)
+		sort_stream(reader, n, static_cast<int>(k), writer, radix_sort_block);
+	else
+		sort_stream_adaptive(reader, n, static_cast<int>(k), writer);
+}
+
+// Последовательность читается потоково с памятью O(k): из stdin или, с --input path, из файла, отображённого в память.
+// Способ сортировки выбирается по k, как в sort_adaptive; --radix всегда сортирует подмассивы длины k поразрядной сортировкой.
+// --threads [count] сортирует параллельно, прочитав последовательность целиком. --benchmark [n], --crossover [n]
+// и --parallel-benchmark [n] [k] запускают замеры
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+	{
+		run_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--parallel-benchmark") == 0)
+	{
+		run_parallel_benchmark(argc > 2 ? std::stoull(argv[2]) : 100000000ULL, argc > 3 ? std::atoi(argv[3]) : 1000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--crossover") == 0)
+	{
+		run_crossover_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000);
+		return 0;
+	}
+	bool use_radix = false;
+	unsigned threads_count = 0;
+	const char* input_path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--radix") == 0)
+			use_radix = true;
+		else if (std::strcmp(argv[i], "--threads") == 0)
+		{
+			threads_count = parallel::default_threads_count();
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				threads_count = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+			input_path = argv[++i];
+	}
+
+	if (input_path)
+	{
+		const MappedFile input_file(input_path);
+		if (!input_file.is_open())
+		{
+			std::cerr << "Cannot open " << input_path << "\n";
+			return 1;
+		}
+		IntegerReader reader(input_file.begin(), input_file.end());
+		sort_input(reader, use_radix, threads_count);
+		return 0;
+	}
+	IntegerReader reader(stdin);
+	sort_input(reader, use_radix, threads_count);
+	return 0;
+}
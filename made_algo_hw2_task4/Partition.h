@@ -0,0 +1,264 @@
+﻿#pragma once
+
+#include "../common/CpuFeatures.h"
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+
+#if CPU_X86 && defined(_MSC_VER)
+#define PARTITION_TARGET_AVX2
+#define PARTITION_TARGET_AVX512
+#elif CPU_X86
+#define PARTITION_TARGET_AVX2 __attribute__((target("avx2")))
+#define PARTITION_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// Варианты partition без ветвлений, зависящих от данных. Контракт тот же: опорный элемент находится в конце массива,
+// после разделения левее него стоят не большие, правее - строго большие элементы, возвращается его позиция.
+// Векторные варианты компилируются для любого процессора x86, а вызываются только на процессорах с нужным набором инструкций
+// (fastest_partition). На других архитектурах доступен только вариант без векторных инструкций
+
+// Функция разделения массива из n элементов с опорным элементом в конце
+typedef int (*partition_function)(int* values, int n);
+
+namespace partition_detail
+{
+	constexpr int block_size = 64; // Размер блока в разделении по блокам, смещения хранятся в байтах
+
+	// Разделение [begin, end) относительно pivot проходом двумя итераторами от начала к концу. Обмен выполняется всегда,
+	// а сдвигается только граница - так нет ветвления. Возвращает границу между не большими и большими pivot
+	inline int lomuto(int* values, int begin, int end, int pivot)
+	{
+		int i = begin;
+		for (int j = begin; j < end; ++j)
+		{
+			const int value = values[j];
+			values[j] = values[i];
+			values[i] = value;
+			i += value <= pivot;
+		}
+		return i;
+	}
+
+	// Раскладывает оставшиеся count элементов rest по краям свободного промежутка [left, right) массива values.
+	// Каждый элемент пишется на оба края, и сдвигается только одна граница
+	inline int distribute(int* values, int left, int right, const int* rest, int count, int pivot)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const int value = rest[i];
+			const bool less = value <= pivot;
+			values[left] = value;
+			values[right - 1] = value;
+			left += less;
+			right -= !less;
+		}
+		return left;
+	}
+
+#if CPU_X86
+	// Перестановки для AVX2: для каждой маски из 8 бит (бит установлен у элемента больше опорного)
+	// индексы, ставящие сначала не большие элементы, затем большие
+	inline const uint8_t* avx2_permutations()
+	{
+		static const struct Table
+		{
+			uint8_t indices[256][8];
+			Table()
+			{
+				for (int mask = 0; mask < 256; ++mask)
+				{
+					int position = 0;
+					for (int lane = 0; lane < 8; ++lane)
+						if ((mask & (1 << lane)) == 0)
+							indices[mask][position++] = static_cast<uint8_t>(lane);
+					for (int lane = 0; lane < 8; ++lane)
+						if ((mask & (1 << lane)) != 0)
+							indices[mask][position++] = static_cast<uint8_t>(lane);
+				}
+			}
+		} table;
+		return &table.indices[0][0];
+	}
+
+	// Разделяет вектор и записывает не большие элементы с позиции left, большие - перед позицией right.
+	// Запись идёт целыми векторами: лишние элементы попадают в свободное место, которого с каждой стороны не меньше вектора
+	PARTITION_TARGET_AVX2 inline void partition_vector(__m256i vector, __m256i pivot, const uint8_t* permutations,
+		int* values, int& left, int& right)
+	{
+		const int greater_mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vector, pivot)));
+		const __m256i permutation = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i*>(permutations + 8 * greater_mask)));
+		const __m256i packed = _mm256_permutevar8x32_epi32(vector, permutation);
+		const int greater_count = static_cast<int>(std::bitset<8>(static_cast<unsigned>(greater_mask)).count());
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(values + left), packed);
+		left += 8 - greater_count;
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(values + right - 8), packed);
+		right -= greater_count;
+	}
+
+	// Сжатие в регистре и обычная запись быстрее compress-store в память, которая на многих процессорах микрокодовая
+	PARTITION_TARGET_AVX512 inline void partition_vector(__m512i vector, __m512i pivot, int* values, int& left, int& right)
+	{
+		const __mmask16 less_mask = _mm512_cmple_epi32_mask(vector, pivot);
+		const int less_count = static_cast<int>(std::bitset<16>(less_mask).count());
+		_mm512_storeu_si512(values + left, _mm512_maskz_compress_epi32(less_mask, vector));
+		left += less_count;
+		right -= 16 - less_count;
+		_mm512_mask_storeu_epi32(values + right, static_cast<__mmask16>((1u << (16 - less_count)) - 1),
+			_mm512_maskz_compress_epi32(static_cast<__mmask16>(~less_mask), vector));
+	}
+#endif
+}
+
+// Разделение по блокам (BlockQuicksort): с двух концов в буферы записываются смещения элементов, стоящих не на своей стороне,
+// - без ветвлений, добавлением результата сравнения к счётчику, - после чего найденные пары обмениваются.
+// Остаток короче двух блоков разделяется проходом без ветвлений
+inline int partition_branchless(int* values, int n)
+{
+	using partition_detail::block_size;
+	if (n <= 1)
+		return 0;
+	const int pivot = values[n - 1];
+	uint8_t left_offsets[block_size];
+	uint8_t right_offsets[block_size];
+	int left = 0; // Начало непросмотренной части
+	int right = n - 2; // Последний элемент непросмотренной части
+	int left_count = 0;
+	int right_count = 0;
+	int left_start = 0;
+	int right_start = 0;
+	while (right - left + 1 > 2 * block_size)
+	{
+		if (left_count == 0)
+		{
+			left_start = 0;
+			for (int i = 0; i < block_size; ++i)
+			{
+				left_offsets[left_count] = static_cast<uint8_t>(i);
+				left_count += values[left + i] > pivot;
+			}
+		}
+		if (right_count == 0)
+		{
+			right_start = 0;
+			for (int i = 0; i < block_size; ++i)
+			{
+				right_offsets[right_count] = static_cast<uint8_t>(i);
+				right_count += values[right - i] <= pivot;
+			}
+		}
+		const int count = std::min(left_count, right_count);
+		for (int i = 0; i < count; ++i)
+			std::swap(values[left + left_offsets[left_start + i]], values[right - right_offsets[right_start + i]]);
+		left_count -= count;
+		right_count -= count;
+		left_start += count;
+		right_start += count;
+		if (left_count == 0)
+			left += block_size;
+		if (right_count == 0)
+			right -= block_size;
+	}
+	const int position = partition_detail::lomuto(values, left, right + 1, pivot);
+	std::swap(values[position], values[n - 1]);
+	return position;
+}
+
+#if CPU_X86
+// Векторное разделение на AVX2. Первый и последний векторы откладываются, освобождая место с обоих краёв;
+// очередной вектор читается с той стороны, где свободного места меньше, и его элементы дописываются к краям.
+// Остаток и отложенные векторы раскладываются поэлементно
+PARTITION_TARGET_AVX2 inline int partition_avx2(int* values, int n)
+{
+	constexpr int width = 8;
+	const int end = n - 1; // Опорный элемент не участвует в разделении
+	if (end < 3 * width)
+		return partition_branchless(values, n);
+	const int pivot = values[end];
+	const __m256i pivot_vector = _mm256_set1_epi32(pivot);
+	const uint8_t* permutations = partition_detail::avx2_permutations();
+
+	int rest[3 * width];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(rest), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)));
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(rest + width),
+		_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + end - width)));
+	int read_left = width;
+	int read_right = end - width;
+	int write_left = 0;
+	int write_right = end;
+	while (read_right - read_left >= width)
+	{
+		__m256i vector;
+		if (read_left - write_left <= write_right - read_right)
+		{
+			vector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + read_left));
+			read_left += width;
+		}
+		else
+		{
+			read_right -= width;
+			vector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + read_right));
+		}
+		partition_detail::partition_vector(vector, pivot_vector, permutations, values, write_left, write_right);
+	}
+	const int rest_count = 2 * width + read_right - read_left;
+	std::copy(values + read_left, values + read_right, rest + 2 * width);
+	const int position = partition_detail::distribute(values, write_left, write_right, rest, rest_count, pivot);
+	std::swap(values[position], values[end]);
+	return position;
+}
+
+// Векторное разделение на AVX-512: устроено как partition_avx2, но вместо таблицы перестановок
+// элементы каждой стороны собираются инструкцией compress
+PARTITION_TARGET_AVX512 inline int partition_avx512(int* values, int n)
+{
+	constexpr int width = 16;
+	const int end = n - 1;
+	if (end < 3 * width)
+		return partition_branchless(values, n);
+	const int pivot = values[end];
+	const __m512i pivot_vector = _mm512_set1_epi32(pivot);
+
+	int rest[3 * width];
+	_mm512_storeu_si512(rest, _mm512_loadu_si512(values));
+	_mm512_storeu_si512(rest + width, _mm512_loadu_si512(values + end - width));
+	int read_left = width;
+	int read_right = end - width;
+	int write_left = 0;
+	int write_right = end;
+	while (read_right - read_left >= width)
+	{
+		__m512i vector;
+		if (read_left - write_left <= write_right - read_right)
+		{
+			vector = _mm512_loadu_si512(values + read_left);
+			read_left += width;
+		}
+		else
+		{
+			read_right -= width;
+			vector = _mm512_loadu_si512(values + read_right);
+		}
+		partition_detail::partition_vector(vector, pivot_vector, values, write_left, write_right);
+	}
+	const int rest_count = 2 * width + read_right - read_left;
+	std::copy(values + read_left, values + read_right, rest + 2 * width);
+	const int position = partition_detail::distribute(values, write_left, write_right, rest, rest_count, pivot);
+	std::swap(values[position], values[end]);
+	return position;
+}
+
+#endif
+
+// Самый быстрый вариант разделения, доступный на этом процессоре. Определяется один раз
+inline partition_function fastest_partition()
+{
+#if CPU_X86
+	static const partition_function fastest = cpu::supports_avx512() ? partition_avx512
+		: cpu::supports_avx2() ? partition_avx2 : partition_branchless;
+	return fastest;
+#else
+	return partition_branchless;
+#endif
+}
@@ -0,0 +1,181 @@
+﻿#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+constexpr size_t kll_min_capacity = 8; // Наименьшая ёмкость уровня скетча
+
+// Скетч KLL (Karnin, Lang, Liberty) для приближённых квантилей потока целых чисел.
+// Уровень h хранит числа с весом 2^h. Когда уровень заполняется, он сортируется, и числа с чётных
+// или - случайно - нечётных позиций переходят на уровень выше с удвоенным весом, а остальные отбрасываются.
+// Ёмкость уровня убывает в 3/2 раза с каждым шагом вниз от верхнего, поэтому память O(accuracy) при любой длине потока,
+// а ошибка ранга при accuracy = 200 - около 1.7% от количества чисел с вероятностью 99%.
+// Добавление - амортизированно O(1) (сортировка уровня делится на добавленные в него числа).
+// Скетчи частей потока, построенные независимо (например, в разных потоках), объединяются merge
+class KllSketch
+{
+public:
+	explicit KllSketch(int accuracy = 200, uint64_t seed = 1);
+
+	// Добавляет число в скетч
+	void add(int value);
+	// Добавляет в скетч все числа, учтённые в other
+	void merge(const KllSketch& other);
+	// Количество учтённых чисел
+	long long count() const;
+	// Количество хранимых чисел
+	size_t retained() const;
+	// Приближённое количество учтённых чисел, не больших value
+	long long rank(int value) const;
+	// Число, перед которым в отсортированной последовательности приблизительно rank чисел. Скетч не должен быть пустым
+	int value_at_rank(long long rank) const;
+	// Квантиль уровня fraction из [0, 1]
+	int quantile(double fraction) const;
+
+private:
+	int accuracy;
+	uint64_t random_state;
+	long long total = 0;
+	size_t retained_count = 0;
+	size_t max_retained = 0; // Суммарная ёмкость уровней, пересчитывается только при добавлении уровня
+	std::vector<std::vector<int>> levels;
+
+	// Ёмкость уровня level при текущем количестве уровней
+	size_t capacity(size_t level) const;
+	// Добавляет уровни до количества levels_count и пересчитывает max_retained
+	void grow(size_t levels_count);
+	// Сжимает самый нижний переполненный уровень
+	void compress();
+	// Переносит половину чисел уровня level на уровень выше
+	void compact(size_t level);
+	bool random_bit();
+};
+
+inline KllSketch::KllSketch(int accuracy, uint64_t seed) : accuracy(accuracy), random_state(seed ? seed : 1)
+{
+	assert(accuracy >= static_cast<int>(kll_min_capacity));
+	grow(1);
+}
+
+inline void KllSketch::add(int value)
+{
+	levels[0].push_back(value);
+	++total;
+	if (++retained_count >= max_retained)
+		compress();
+}
+
+inline void KllSketch::merge(const KllSketch& other)
+{
+	if (levels.size() < other.levels.size())
+		grow(other.levels.size());
+	for (size_t level = 0; level < other.levels.size(); ++level)
+		levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+	total += other.total;
+	retained_count += other.retained_count;
+	while (retained_count >= max_retained)
+		compress();
+}
+
+inline long long KllSketch::count() const
+{
+	return total;
+}
+
+inline size_t KllSketch::retained() const
+{
+	return retained_count;
+}
+
+inline long long KllSketch::rank(int value) const
+{
+	long long result = 0;
+	for (size_t level = 0; level < levels.size(); ++level)
+	{
+		const long long not_greater = std::count_if(levels[level].begin(), levels[level].end(),
+			[value](int item) { return item <= value; });
+		result += not_greater << level;
+	}
+	return result;
+}
+
+inline int KllSketch::value_at_rank(long long rank) const
+{
+	assert(total > 0);
+	std::vector<std::pair<int, long long>> weighted;
+	weighted.reserve(retained_count);
+	for (size_t level = 0; level < levels.size(); ++level)
+		for (const int item : levels[level])
+			weighted.emplace_back(item, 1LL << level);
+	std::sort(weighted.begin(), weighted.end());
+	long long preceding = 0;
+	for (const auto& item : weighted)
+	{
+		preceding += item.second;
+		if (preceding > rank)
+			return item.first;
+	}
+	return weighted.back().first;
+}
+
+inline int KllSketch::quantile(double fraction) const
+{
+	return value_at_rank(static_cast<long long>(fraction * static_cast<double>(total)));
+}
+
+inline size_t KllSketch::capacity(size_t level) const
+{
+	const double scale = std::pow(2.0 / 3.0, static_cast<double>(levels.size() - 1 - level));
+	return std::max(kll_min_capacity, static_cast<size_t>(std::ceil(accuracy * scale)));
+}
+
+inline void KllSketch::grow(size_t levels_count)
+{
+	levels.resize(levels_count);
+	max_retained = 0;
+	for (size_t level = 0; level < levels.size(); ++level)
+		max_retained += capacity(level);
+}
+
+inline void KllSketch::compress()
+{
+	for (size_t level = 0; level < levels.size(); ++level)
+	{
+		if (levels[level].size() >= capacity(level))
+		{
+			if (level + 1 == levels.size())
+				grow(levels.size() + 1);
+			compact(level);
+			return;
+		}
+	}
+}
+
+inline void KllSketch::compact(size_t level)
+{
+	std::vector<int>& items = levels[level];
+	std::vector<int>& upper = levels[level + 1];
+	std::sort(items.begin(), items.end());
+	// При нечётном количестве последнее число остаётся на уровне
+	const size_t pairs = items.size() / 2;
+	const size_t offset = random_bit() ? 1 : 0;
+	for (size_t i = 0; i < pairs; ++i)
+		upper.push_back(items[2 * i + offset]);
+	if (items.size() % 2 == 1)
+		items[0] = items.back();
+	items.resize(items.size() % 2);
+	retained_count -= pairs;
+}
+
+inline bool KllSketch::random_bit()
+{
+	// xorshift64
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return (random_state >> 63) != 0;
+}
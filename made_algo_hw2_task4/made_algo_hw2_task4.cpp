@@ -5,8 +5,19 @@
 // 4_1.Реализуйте стратегию выбора опорного элемента “медиана трёх”.
 // Функцию Partition реализуйте методом прохода двумя итераторами от начала массива к концу.
 
+#include "../common/Parallel.h"
+#include "Partition.h"
+#include "QuantileSketch.h"
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
 
 // Возвращает индекс, в который помещается опорный элемент после разделения
 // Предполагается, что изначально опорный элемент находится в конце массива
@@ -48,41 +59,550 @@ void set_pivot(int* values, int n)
 	std::swap(values[mid], values[last]);
 }
 
+// Подмассивы не длиннее этого сортируются вставками
+constexpr int selection_cutoff = 16;
+// С этого размера опорный элемент выбирается по выборке (Флойд - Ривест)
+constexpr int floyd_rivest_min_size = 600;
+// После стольких разделений, не уменьшивших подмассив хотя бы на четверть, опорным становится медиана медиан
+constexpr int max_bad_partitions = 4;
+
+// Сортировка вставками для коротких подмассивов
+void insertion_sort(int* values, int n)
+{
+	for (int i = 1; i < n; ++i)
+	{
+		const int value = values[i];
+		int j = i;
+		for (; j > 0 && values[j - 1] > value; --j)
+			values[j] = values[j - 1];
+		values[j] = value;
+	}
+}
+
+// Переносит в начало массива элементы, строго меньшие pivot, тем же проходом двумя итераторами, что и partition.
+// Возвращает их количество. Применяется к левой части после partition, где все элементы не больше pivot:
+// остаток этой части состоит из копий pivot
+int partition_less(int* values, int n, int pivot)
+{
+	int i = 0;
+	for (int j = 0; j < n; ++j)
+		if (values[j] < pivot)
+			std::swap(values[i++], values[j]);
+	return i;
+}
+
+// Опорный элемент по методу Флойда - Ривеста: в начало массива собирается равномерная выборка, она сортируется,
+// и берётся её элемент, стоящий чуть правее (или левее) места, куда попала бы k-я статистика.
+// Тогда после разделения k-я статистика почти наверняка окажется в меньшей части, а при следующем шаге - у самого края.
+// Возвращает позицию опорного элемента
+int floyd_rivest_pivot(int* values, int n, int k)
+{
+	const double size = n;
+	const int sample_size = static_cast<int>(0.5 * std::exp(2.0 * std::log(size) / 3.0));
+	const int gap = static_cast<int>(0.5 * std::sqrt(std::log(size) * sample_size * (size - sample_size) / size));
+	for (int i = 0; i < sample_size; ++i)
+		std::swap(values[i], values[static_cast<long long>(i) * n / sample_size]);
+	std::sort(values, values + sample_size);
+	const int sample_rank = static_cast<int>(static_cast<long long>(k) * sample_size / n);
+	// Опорный элемент берётся со стороны более длинной части, чтобы её отсечь
+	const int rank = k < n / 2 ? std::min(sample_rank + gap, sample_size - 1) : std::max(sample_rank - gap, 0);
+	return rank;
+}
+
+// Сортирует группы по 5 элементов и переносит их медианы в начало массива. Возвращает количество медиан
+int gather_medians_of_five(int* values, int n)
+{
+	const int groups_count = n / 5;
+	for (int group = 0; group < groups_count; ++group)
+	{
+		insertion_sort(values + 5 * group, 5);
+		std::swap(values[group], values[5 * group + 2]);
+	}
+	return groups_count;
+}
+
+// Подмассив, в котором ищется порядковая статистика
+struct SelectionFrame
+{
+	int* start;
+	int size;
+	int k;
+	int medians_count; // Если не 0, в начале подмассива собраны медианы пятёрок и над фреймом ищется их медиана
+	int bad_partitions; // Количество разделений, почти не уменьшивших подмассив
+};
+
+// Переставляет массив так, что на позиции k оказывается k-я порядковая статистика, левее - не большие, правее - не меньшие.
+// Опорный элемент - медиана трёх, на больших подмассивах - по выборке Флойда - Ривеста, а если несколько разделений
+// оказались неудачными - медиана медиан пятёрок, гарантирующая линейное время.
+// Её медиана ищется тем же циклом во вложенном фрейме на явном стеке, без рекурсии.
+// Копии опорного элемента отделяются вторым проходом, поэтому массивы из одинаковых чисел обрабатываются за O(n).
+// Разделение выполняет partition_range - по умолчанию самый быстрый вариант для этого процессора.
+// Возвращает k-ю порядковую статистику
+int get_k_order_statistic_in_place(int* values, int n, int k, partition_function partition_range = fastest_partition())
+{
+	assert(k >= 0 && k < n);
+	// Каждый вложенный фрейм впятеро меньше предыдущего, поэтому глубина стека не превосходит log5(n)
+	SelectionFrame stack[16];
+	int depth = 0;
+	stack[0] = SelectionFrame{ values, n, k, 0, 0 };
+	while (true)
+	{
+		SelectionFrame& frame = stack[depth];
+		int pivot_position = 0;
+		if (frame.medians_count > 0)
+		{
+			// Вложенный фрейм поставил медиану медиан на её место среди медиан
+			pivot_position = frame.medians_count / 2;
+			frame.medians_count = 0;
+		}
+		else if (frame.size <= selection_cutoff)
+		{
+			insertion_sort(frame.start, frame.size);
+			if (depth == 0)
+				return frame.start[frame.k];
+			--depth;
+			continue;
+		}
+		else if (frame.bad_partitions >= max_bad_partitions)
+		{
+			frame.medians_count = gather_medians_of_five(frame.start, frame.size);
+			stack[depth + 1] = SelectionFrame{ frame.start, frame.medians_count, frame.medians_count / 2, 0, max_bad_partitions };
+			++depth;
+			continue;
+		}
+		else if (frame.size >= floyd_rivest_min_size)
+		{
+			pivot_position = floyd_rivest_pivot(frame.start, frame.size, frame.k);
+		}
+		else
+		{
+			set_pivot(frame.start, frame.size);
+			pivot_position = frame.size - 1;
+		}
+
+		std::swap(frame.start[pivot_position], frame.start[frame.size - 1]);
+		const int position = partition_range(frame.start, frame.size); // Позиция опорного элемента после разделения
+		const int old_size = frame.size;
+		if (position == frame.k)
+		{
+			if (depth == 0)
+				return frame.start[position];
+			--depth;
+			continue;
+		}
+		else if (position > frame.k) // Искомая статистика находится левее опорного элемента
+		{
+			// Слева все элементы не больше опорного. Если их слишком много, среди них могут быть его копии: отделим их
+			if (position > old_size - old_size / 4)
+			{
+				const int less_count = partition_less(frame.start, position, frame.start[position]);
+				if (frame.k >= less_count)
+				{
+					if (depth == 0)
+						return frame.start[frame.k];
+					--depth;
+					continue;
+				}
+				frame.size = less_count;
+			}
+			else
+			{
+				frame.size = position;
+			}
+		}
+		else // Искомая статистика находится правее опорного элемента
+		{
+			frame.start += position + 1;
+			frame.size -= position + 1;
+			frame.k -= position + 1;
+		}
+		if (frame.size > old_size - old_size / 4)
+			++frame.bad_partitions;
+	}
+}
+
 // Возвращает k-ю порядковую статистику массива values
 // Массив не изменяется
 int get_k_order_statistic(const int* values, int n, int k)
 {
 	int* arr = new int[n];
 	std::copy(values, values + n, arr);
-	int* start = arr; // Начало подмассива, в котором будем искать k-ю порядковую статистику
-	int size = n; // Размер этого подмассива
-	int statistic = 0;
-	while (true)
+	const int statistic = get_k_order_statistic_in_place(arr, n, k);
+	delete[] arr;
+	return statistic;
+}
+
+// Подмассив [begin, end) и попадающие в него запросы: order[first..last) из упорядоченных по возрастанию статистик
+struct QuantilesFrame
+{
+	int begin;
+	int end;
+	int first;
+	int last;
+};
+
+// Записывает в statistics[i] ks[i]-ю порядковую статистику массива values для всех i из [0, count). Массив переставляется.
+// В подмассиве ищется средняя из попавших в него статистик; она встаёт на своё место и делит подмассив на два,
+// каждый со своей частью оставшихся статистик. Подмассивы без запрошенных статистик больше не просматриваются,
+// поэтому время O(n * log(count)), а для нескольких квантилей - порядка одного-двух проходов по массиву.
+// Подмассивы обрабатываются в цикле по явному стеку
+void get_order_statistics_in_place(int* values, int n, const int* ks, int count, int* statistics,
+	partition_function partition_range = fastest_partition())
+{
+	// Номера запросов в порядке возрастания статистик
+	std::vector<int> order(count);
+	for (int i = 0; i < count; ++i)
+	{
+		assert(ks[i] >= 0 && ks[i] < n);
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [ks](int left, int right) { return ks[left] < ks[right]; });
+
+	std::vector<QuantilesFrame> stack;
+	if (count > 0)
+		stack.push_back(QuantilesFrame{ 0, n, 0, count });
+	while (!stack.empty())
+	{
+		const QuantilesFrame frame = stack.back();
+		stack.pop_back();
+		const int k = ks[order[(frame.first + frame.last) / 2]];
+		const int statistic = get_k_order_statistic_in_place(values + frame.begin, frame.end - frame.begin,
+			k - frame.begin, partition_range);
+		// Одинаковые запросы получают ответ вместе
+		int equal_first = (frame.first + frame.last) / 2;
+		while (equal_first > frame.first && ks[order[equal_first - 1]] == k)
+			--equal_first;
+		int equal_last = equal_first;
+		for (; equal_last < frame.last && ks[order[equal_last]] == k; ++equal_last)
+			statistics[order[equal_last]] = statistic;
+
+		if (equal_first > frame.first)
+			stack.push_back(QuantilesFrame{ frame.begin, k, frame.first, equal_first });
+		if (equal_last < frame.last)
+			stack.push_back(QuantilesFrame{ k + 1, frame.end, equal_last, frame.last });
+	}
+}
+
+// Записывает в statistics[i] ks[i]-ю порядковую статистику массива values для всех i из [0, count)
+// Массив не изменяется, копируется один раз на все запросы
+void get_order_statistics(const int* values, int n, const int* ks, int count, int* statistics)
+{
+	int* arr = new int[n];
+	std::copy(values, values + n, arr);
+	get_order_statistics_in_place(arr, n, ks, count, statistics);
+	delete[] arr;
+}
+
+// Диапазоны короче этого (около 1 МБ - порядок размера кэша L2) выбираются последовательно
+constexpr int parallel_selection_min_size = 1 << 18;
+// Наибольший размер выборки для опорных элементов параллельного выбора
+constexpr int parallel_sample_max_size = 1 << 16;
+
+// Возвращает k-ю порядковую статистику массива values, используя до threads_count потоков (хотя бы один). Массив не изменяется.
+// По выборке выбираются два опорных элемента, между которыми почти наверняка лежит k-я статистика.
+// Каждый поток считает в своей части элементы меньше, между и больше опорных; префиксные суммы счётчиков
+// показывают, в какую из трёх групп попала k-я статистика и куда каждому потоку писать. Только эта группа
+// переносится в буфер, и шаг повторяется над ней. Когда она помещается в L2, выбор завершается последовательно.
+// Даже в одном потоке это быстрее get_k_order_statistic: весь массив читается, но не копируется
+int get_k_order_statistic_parallel(const int* values, int n, int k, unsigned threads_count)
+{
+	assert(k >= 0 && k < n);
+	threads_count = std::max(1u, threads_count);
+	const int* candidates = values; // Элементы, среди которых находится искомая статистика
+	int size = n;
+	std::vector<int> buffer;
+	std::vector<int> next_buffer;
+	while (size > parallel_selection_min_size)
+	{
+		// Выборка с равным шагом, её элементы по обе стороны от места k-й статистики - опорные
+		const double length = size;
+		const int sample_size = std::min(parallel_sample_max_size, static_cast<int>(0.5 * std::exp(2.0 * std::log(length) / 3.0)));
+		const int gap = static_cast<int>(0.5 * std::sqrt(std::log(length) * sample_size));
+		std::vector<int> sample(sample_size);
+		for (int i = 0; i < sample_size; ++i)
+			sample[i] = candidates[static_cast<long long>(i) * size / sample_size];
+		std::sort(sample.begin(), sample.end());
+		const int sample_rank = static_cast<int>(static_cast<long long>(k) * sample_size / size);
+		const int low = sample[std::max(sample_rank - gap, 0)];
+		const int high = sample[std::min(sample_rank + gap, sample_size - 1)];
+
+		// counts[3 * t + g] - количество элементов группы g (меньше low, от low до high, больше high) в части потока t
+		std::vector<int> counts(3 * static_cast<size_t>(threads_count));
+		parallel::for_each_chunk(size, threads_count, [&](unsigned thread, size_t begin, size_t end)
+		{
+			int less = 0;
+			int greater = 0;
+			for (size_t i = begin; i < end; ++i)
+			{
+				less += candidates[i] < low;
+				greater += candidates[i] > high;
+			}
+			counts[3 * thread] = less;
+			counts[3 * thread + 1] = static_cast<int>(end - begin) - less - greater;
+			counts[3 * thread + 2] = greater;
+		});
+		int totals[3] = { 0, 0, 0 };
+		for (unsigned t = 0; t < threads_count; ++t)
+			for (int group = 0; group < 3; ++group)
+				totals[group] += counts[3 * t + group];
+		const int group = k < totals[0] ? 0 : k < totals[0] + totals[1] ? 1 : 2;
+		if (group == 1 && low == high)
+			return low; // Все элементы средней группы равны
+		if (totals[group] == size)
+			break; // Выборка не отсекла ничего - например, в массиве всего два различных значения
+		k -= group == 0 ? 0 : group == 1 ? totals[0] : totals[0] + totals[1];
+
+		// Смещения потоков в буфере - префиксные суммы их счётчиков выбранной группы
+		std::vector<int> offsets(threads_count);
+		for (unsigned t = 1; t < threads_count; ++t)
+			offsets[t] = offsets[t - 1] + counts[3 * (t - 1) + group];
+		next_buffer.resize(totals[group]);
+		int* destination = next_buffer.data();
+		parallel::for_each_chunk(size, threads_count, [&](unsigned thread, size_t begin, size_t end)
+		{
+			int position = offsets[thread];
+			// Ветвление предсказуемо: в выбранную группу попадает малая доля элементов
+			for (size_t i = begin; i < end; ++i)
+			{
+				const int value = candidates[i];
+				if ((value >= low) + (value > high) == group)
+					destination[position++] = value;
+			}
+		});
+		size = totals[group];
+		buffer.swap(next_buffer);
+		candidates = buffer.data();
+	}
+	if (candidates == values)
+		return get_k_order_statistic(values, size, k);
+	return get_k_order_statistic_in_place(buffer.data(), size, k);
+}
+
+// Время на элемент поиска медианы и 1-го процентиля на распределениях, на которых выбор опорного элемента
+// медианой трёх и разделение с копиями опорного элемента деградируют до квадратичного времени
+void run_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	const char* names[] = { "random", "sorted", "reversed", "equal", "few distinct", "organ pipe" };
+	std::vector<int> values(n);
+	std::cout << "input\tmedian ns/element\tpercentile ns/element\n";
+	for (int distribution = 0; distribution < 6; ++distribution)
 	{
-		set_pivot(start, size); // Находим опроный элемент в подмассиве и помещаем его в конец
-		int position = partition(start, size); // Позиция опорного элемента после разделения
-		if (position == k)
+		for (int i = 0; i < n; ++i)
 		{
-			statistic = *(start + position);
-			break;
+			switch (distribution)
+			{
+			case 0: values[i] = static_cast<int>(generator() % 1000000001); break;
+			case 1: values[i] = i; break;
+			case 2: values[i] = n - i; break;
+			case 3: values[i] = 7; break;
+			case 4: values[i] = static_cast<int>(generator() % 4); break;
+			default: values[i] = i < n / 2 ? i : n - i; break;
+			}
 		}
-		else if (position > k) // Искомая статистика находится левее опорного элемента
+		std::cout << names[distribution];
+		for (const int k : { n / 2, n / 100 })
 		{
-			size = position;
+			std::vector<int> copy = values;
+			const auto start_time = std::chrono::steady_clock::now();
+			const int statistic = get_k_order_statistic_in_place(copy.data(), n, k);
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start_time;
+			std::nth_element(values.begin(), values.begin() + k, values.end());
+			std::cout << "\t" << elapsed.count() / n << (statistic == values[k] ? "" : " WRONG");
 		}
-		else // Искомая статистика находится правее опорного элемента
+		std::cout << "\n";
+	}
+}
+
+// Время поиска p50, p90, p99 и p99.9 случайного массива из n элементов отдельными вызовами get_k_order_statistic
+// и одним вызовом get_order_statistics
+void run_quantiles_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (int& value : values)
+		value = static_cast<int>(generator() % 1000000001);
+	const int ks[] = { n / 2, static_cast<int>(n * 0.9), static_cast<int>(n * 0.99), static_cast<int>(n * 0.999) };
+	const int count = sizeof(ks) / sizeof(ks[0]);
+
+	int separate[count];
+	auto start_time = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+		separate[i] = get_k_order_statistic(values.data(), n, ks[i]);
+	const std::chrono::duration<double, std::milli> separate_time = std::chrono::steady_clock::now() - start_time;
+
+	int batch[count];
+	start_time = std::chrono::steady_clock::now();
+	get_order_statistics(values.data(), n, ks, count, batch);
+	const std::chrono::duration<double, std::milli> batch_time = std::chrono::steady_clock::now() - start_time;
+
+	std::cout << "separate calls: " << separate_time.count() << " ms\n"
+		<< "get_order_statistics: " << batch_time.count() << " ms"
+		<< (std::equal(separate, separate + count, batch) ? "" : " WRONG") << "\n";
+}
+
+// Время поиска медианы случайного массива из n элементов последовательно и параллельно при 1, 2, 4, ... потоках
+void run_parallel_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (int& value : values)
+		value = static_cast<int>(generator() % 1000000001);
+	const int k = n / 2;
+
+	auto start_time = std::chrono::steady_clock::now();
+	const int expected = get_k_order_statistic(values.data(), n, k);
+	const std::chrono::duration<double, std::milli> serial_time = std::chrono::steady_clock::now() - start_time;
+	std::cout << "serial: " << serial_time.count() << " ms\nthreads\tms\tspeedup\n";
+
+	const unsigned max_threads = std::max(2u, parallel::default_threads_count());
+	for (unsigned threads_count = 1; threads_count <= max_threads; threads_count *= 2)
+	{
+		start_time = std::chrono::steady_clock::now();
+		const int statistic = get_k_order_statistic_parallel(values.data(), n, k, threads_count);
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+		std::cout << threads_count << "\t" << elapsed.count() << "\t" << serial_time.count() / elapsed.count()
+			<< (statistic == expected ? "" : " WRONG") << "\n";
+	}
+}
+
+// Скорость добавления в KllSketch в одном потоке и во всех потоках с объединением скетчей,
+// и ошибка ранга его квантилей относительно точных, найденных get_order_statistics
+void run_sketch_benchmark(int n, int accuracy)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (int& value : values)
+		value = static_cast<int>(generator() % 1000000001);
+
+	auto start_time = std::chrono::steady_clock::now();
+	KllSketch sketch(accuracy);
+	for (const int value : values)
+		sketch.add(value);
+	const std::chrono::duration<double> single_time = std::chrono::steady_clock::now() - start_time;
+
+	const unsigned threads_count = parallel::default_threads_count();
+	start_time = std::chrono::steady_clock::now();
+	std::vector<KllSketch> thread_sketches(threads_count, KllSketch(accuracy));
+	parallel::for_each_chunk(n, threads_count, [&](unsigned thread, size_t begin, size_t end)
+	{
+		KllSketch& thread_sketch = thread_sketches[thread];
+		thread_sketch = KllSketch(accuracy, thread + 1); // Разные потоки - разные случайные последовательности
+		for (size_t i = begin; i < end; ++i)
+			thread_sketch.add(values[i]);
+	});
+	KllSketch merged(accuracy);
+	for (const KllSketch& thread_sketch : thread_sketches)
+		merged.merge(thread_sketch);
+	const std::chrono::duration<double> parallel_time = std::chrono::steady_clock::now() - start_time;
+
+	std::cout << "1 thread: " << n / single_time.count() / 1e6 << " M values/s, "
+		<< threads_count << " threads with merge: " << n / parallel_time.count() / 1e6 << " M values/s, "
+		<< "retained " << sketch.retained() << " of " << n << "\n";
+
+	const double fractions[] = { 0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999 };
+	const int count = sizeof(fractions) / sizeof(fractions[0]);
+	int ks[count];
+	for (int i = 0; i < count; ++i)
+		ks[i] = std::min(n - 1, static_cast<int>(fractions[i] * n));
+	int exact[count];
+	get_order_statistics(values.data(), n, ks, count, exact);
+
+	std::cout << "quantile\texact\tsketch\tmerged\trank error\tmerged rank error\n";
+	for (int i = 0; i < count; ++i)
+	{
+		std::cout << fractions[i] << "\t" << exact[i];
+		double errors[2];
+		const KllSketch* sketches[] = { &sketch, &merged };
+		for (int j = 0; j < 2; ++j)
 		{
-			start += position + 1;
-			size -= position + 1;
-			k -= position + 1;
+			// Ошибка - расстояние от искомого ранга до диапазона рангов, которые занимает найденное число
+			const int estimate = sketches[j]->quantile(fractions[i]);
+			const long long less = std::count_if(values.begin(), values.end(), [estimate](int value) { return value < estimate; });
+			const long long not_greater = std::count_if(values.begin(), values.end(), [estimate](int value) { return value <= estimate; });
+			const long long target = ks[i];
+			errors[j] = static_cast<double>(target < less ? less - target : target >= not_greater ? target - not_greater + 1 : 0) / n;
+			std::cout << "\t" << estimate;
 		}
+		std::cout << "\t" << errors[0] * 100 << "%\t" << errors[1] * 100 << "%\n";
+	}
+}
+
+// Тактов процессора (не на x86 - наносекунд) на элемент для каждого варианта разделения случайного массива из n элементов
+void run_partition_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (int& value : values)
+		value = static_cast<int>(generator() % 1000000001);
+
+	struct Variant
+	{
+		const char* name;
+		partition_function function;
+		bool supported;
+	};
+	const Variant variants[] = {
+		{ "two iterators", partition, true },
+		{ "branchless blocks", partition_branchless, true },
+#if CPU_X86
+		{ "avx2", partition_avx2, cpu::supports_avx2() },
+		{ "avx512", partition_avx512, cpu::supports_avx512() },
+#endif
+	};
+	int expected_position = -1;
+	for (const Variant& variant : variants)
+	{
+		if (!variant.supported)
+		{
+			std::cout << variant.name << ": not supported\n";
+			continue;
+		}
+		std::vector<int> copy = values;
+		const unsigned long long start_time = cpu::timestamp();
+		const int position = variant.function(copy.data(), n);
+		const unsigned long long elapsed = cpu::timestamp() - start_time;
+		if (expected_position < 0)
+			expected_position = position;
+		const bool correct = position == expected_position &&
+			std::all_of(copy.begin(), copy.begin() + position, [&](int value) { return value <= copy[position]; }) &&
+			std::all_of(copy.begin() + position + 1, copy.end(), [&](int value) { return value > copy[position]; });
+		std::cout << variant.name << ": " << static_cast<double>(elapsed) / n << " " << cpu::timestamp_unit << "/element"
+			<< (correct ? "" : " WRONG") << "\n";
 	}
-	delete[] arr;
-	return statistic;
 }
 
-int main()
+// --approximate [accuracy] читает числа потоком в KllSketch и печатает приближённую статистику, не храня массив.
+// --benchmark [n], --partition-benchmark [n], --quantiles-benchmark [n], --parallel-benchmark [n]
+// и --sketch-benchmark [n] [accuracy] запускают замеры
+int main(int argc, char* argv[])
 {
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+	{
+		run_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--sketch-benchmark") == 0)
+	{
+		run_sketch_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000, argc > 3 ? std::atoi(argv[3]) : 200);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--parallel-benchmark") == 0)
+	{
+		run_parallel_benchmark(argc > 2 ? std::atoi(argv[2]) : 100000000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--quantiles-benchmark") == 0)
+	{
+		run_quantiles_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--partition-benchmark") == 0)
+	{
+		run_partition_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000000);
+		return 0;
+	}
+
 	std::ios_base::sync_with_stdio(false);
 	std::cin.tie(nullptr);
 
@@ -92,12 +612,25 @@ int main()
 	int k = 0;
 	std::cin >> k;
 
+	if (argc > 1 && std::strcmp(argv[1], "--approximate") == 0)
+	{
+		KllSketch sketch(argc > 2 ? std::atoi(argv[2]) : 200);
+		int value = 0;
+		for (int i = 0; i < n && std::cin >> value; ++i)
+			sketch.add(value);
+		if (sketch.count() > 0)
+			std::cout << sketch.value_at_rank(k);
+		std::cout.flush();
+		return 0;
+	}
+
 	int* values = new int[n];
 
 	for (int i = 0; i < n; ++i)
 		std::cin >> values[i];
 
-	int result = get_k_order_statistic(values, n, k);
+	// Массив больше не нужен, поэтому копировать его незачем
+	int result = get_k_order_statistic_in_place(values, n, k);
 
 	std::cout << result;
 	std::cout.flush();
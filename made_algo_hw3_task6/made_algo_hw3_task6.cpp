@@ -5,10 +5,27 @@
 //  6_4. Выведите элементы в порядке level-order (по слоям, “в ширину”).
 //
 
+#include "../common/Parallel.h"
+#include "../common/StreamIO.h"
 #include <iostream>
-#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
 
-// Узел бинарного дерева
+// Индекс узла в массиве узлов дерева. 32 бит хватает на любое допустимое N и вдвое меньше указателя
+typedef uint32_t node_index;
+// Индекс отсутствующего потомка
+constexpr node_index no_node = UINT32_MAX;
+// Меньшие части слоя не окупают запуск потока при параллельном обходе
+constexpr size_t parallel_level_min_size = 1 << 15;
+
+// Узел бинарного дерева. Потомки задаются индексами в массиве узлов, поэтому узел занимает 12 байт
 struct BinaryTreeNode
 {
 	explicit BinaryTreeNode(int _value) : value(_value)
@@ -16,111 +33,454 @@ struct BinaryTreeNode
 	}
 
 	int value;
-	BinaryTreeNode* left = nullptr;
-	BinaryTreeNode* right = nullptr;
+	node_index left = no_node;
+	node_index right = no_node;
 };
 
-// Бинарное дерево поиска
+static_assert(sizeof(BinaryTreeNode) == 12, "BinaryTreeNode must stay 12 bytes");
+
+// Бинарное дерево поиска.
+// Узлы лежат подряд в одном массиве (арене): добавление не выделяет память для каждого узла отдельно,
+// а всё дерево освобождается одним освобождением массива
 class BinaryTree
 {
 public:
-	~BinaryTree();
+	// Выделяет память сразу под count узлов
+	void reserve(int count);
 
-	void traverse_level_order(void (*action)(BinaryTreeNode*));
+	// Обходит элементы дерева и вызывает для них action(node) в порядке level-order.
+	// Широкие слои раскрываются в threads_count потоков, action всегда вызывается в вызывающем потоке
+	template <class Action>
+	void traverse_level_order(Action action, unsigned threads_count = 1);
 
 	void add(int value);
 
 private:
-	BinaryTreeNode* root = nullptr;
+	std::vector<BinaryTreeNode> nodes; // Корень - nodes[0]
 };
 
-BinaryTree::~BinaryTree()
+void BinaryTree::reserve(int count)
 {
-	traverse_level_order([](BinaryTreeNode* node)
-	{
-		delete node;
-	});
+	nodes.reserve(count);
 }
 
 // Добавляет новый элемент в бинарное дерево поиска без использования рекурсии
 void BinaryTree::add(int value)
 {
-	if (!root)
+	const node_index added = static_cast<node_index>(nodes.size());
+	nodes.emplace_back(value);
+	if (added == 0)
+		return;
+	node_index node = 0;
+	while (true)
 	{
-		root = new BinaryTreeNode(value);
+		// Ссылка на поле потомка, в которое, возможно, будет записан новый узел
+		node_index& child = nodes[node].value <= value ? nodes[node].right : nodes[node].left;
+		if (child == no_node)
+		{
+			child = added;
+			return;
+		}
+		node = child;
 	}
-	else
+}
+
+// Обходит узлы дерева с корнем root, хранящиеся в массиве nodes, и вызывает для них action(node) в порядке level-order.
+// Очередь обхода - плоский массив индексов на все узлы: каждый узел попадает в очередь ровно один раз,
+// поэтому ни голова, ни хвост не выходят за его границы и память выделяется один раз.
+// Слои не меньше parallel_level_min_size узлов на поток раскрываются параллельно: каждый поток считает детей
+// своей части слоя, префиксные суммы счётчиков дают каждому потоку место в следующем слое, и потоки записывают
+// туда детей в том же порядке, что и последовательный обход. Затем action вызывается для узлов слоя по порядку
+template <class Node, class Action>
+void traverse_nodes_level_order(std::vector<Node>& nodes, node_index root, Action action, unsigned threads_count = 1)
+{
+	if (root == no_node)
+		return;
+	std::vector<node_index> queue(nodes.size());
+	std::vector<size_t> offsets(std::max(1u, threads_count));
+	size_t head = 0;
+	size_t tail = 0;
+	queue[tail++] = root;
+	while (head < tail)
 	{
-		BinaryTreeNode* node = root;
-		while (true)
+		const size_t level_begin = head;
+		const size_t level_size = tail - level_begin;
+		const unsigned level_threads = static_cast<unsigned>(std::min<size_t>(threads_count,
+			level_size / parallel_level_min_size));
+		if (level_threads <= 1)
 		{
-			if (node->value <= value)
+			for (const size_t level_end = tail; head < level_end; ++head)
 			{
-				if (!node->right)
-				{
-					node->right = new BinaryTreeNode(value);
-					return;
-				}
-				node = node->right;
+				Node& node = nodes[queue[head]];
+				action(node);
+				if (node.left != no_node)
+					queue[tail++] = node.left;
+				if (node.right != no_node)
+					queue[tail++] = node.right;
 			}
-			else
+			continue;
+		}
+
+		parallel::for_each_chunk(level_size, level_threads, [&](unsigned thread, size_t begin, size_t end)
+		{
+			size_t children_count = 0;
+			for (size_t i = level_begin + begin; i < level_begin + end; ++i)
 			{
-				if (!node->left)
-				{
-					node->left = new BinaryTreeNode(value);
-					return;
-				}
-				node = node->left;
+				const Node& node = nodes[queue[i]];
+				children_count += (node.left != no_node) + (node.right != no_node);
 			}
+			offsets[thread] = children_count;
+		});
+		for (unsigned t = 0; t < level_threads; ++t)
+		{
+			const size_t children_count = offsets[t];
+			offsets[t] = tail;
+			tail += children_count;
 		}
+		parallel::for_each_chunk(level_size, level_threads, [&](unsigned thread, size_t begin, size_t end)
+		{
+			size_t position = offsets[thread];
+			for (size_t i = level_begin + begin; i < level_begin + end; ++i)
+			{
+				const Node& node = nodes[queue[i]];
+				if (node.left != no_node)
+					queue[position++] = node.left;
+				if (node.right != no_node)
+					queue[position++] = node.right;
+			}
+		});
+		for (; head < level_begin + level_size; ++head)
+			action(nodes[queue[head]]);
 	}
 }
 
-// Обходит элементы дерева и применяет к ним функцию action в порядке level-order
-void BinaryTree::traverse_level_order(void (*action)(BinaryTreeNode*))
+template <class Action>
+void BinaryTree::traverse_level_order(Action action, unsigned threads_count)
+{
+	traverse_nodes_level_order(nodes, nodes.empty() ? no_node : 0, action, threads_count);
+}
+
+// Узел АВЛ-дерева: узел BinaryTreeNode и высота его поддерева
+struct AvlTreeNode
+{
+	explicit AvlTreeNode(int _value) : value(_value)
+	{
+	}
+
+	int value;
+	node_index left = no_node;
+	node_index right = no_node;
+	uint8_t height = 1;
+};
+
+static_assert(sizeof(AvlTreeNode) <= 16, "AvlTreeNode must fit 16 bytes");
+
+// Сбалансированное (АВЛ) дерево поиска с интерфейсом BinaryTree: на отсортированных и почти отсортированных
+// последовательностях высота остаётся O(log n), а не вырождается в список. Равные ключи при добавлении идут направо,
+// но повороты могут перенести их налево, так что level-order в общем случае отличается от наивного дерева.
+// Узлы так же лежат в одном массиве, вставка итеративная: путь от корня запоминается в массиве на стеке
+class AvlTree
 {
-	if (!root)
+public:
+	// Выделяет память сразу под count узлов
+	void reserve(int count);
+
+	// Обходит элементы дерева и вызывает для них action(node) в порядке level-order.
+	// Широкие слои раскрываются в threads_count потоков, action всегда вызывается в вызывающем потоке
+	template <class Action>
+	void traverse_level_order(Action action, unsigned threads_count = 1);
+
+	void add(int value);
+
+	// Заменяет содержимое дерева идеально сбалансированным деревом из n чисел, отсортированных по возрастанию, за O(n)
+	void build_from_sorted(const int* values, int n);
+
+private:
+	// Высота АВЛ-дерева из 2^32 узлов меньше 1.45 * 32
+	static constexpr int max_height = 48;
+
+	std::vector<AvlTreeNode> nodes;
+	node_index root = no_node;
+
+	int height(node_index node) const;
+	// Разность высот правого и левого поддеревьев
+	int balance_factor(node_index node) const;
+	void fix_height(node_index node);
+	// Повороты и балансировка возвращают новый корень поддерева
+	node_index rotate_right(node_index node);
+	node_index rotate_left(node_index node);
+	node_index balance(node_index node);
+};
+
+void AvlTree::reserve(int count)
+{
+	nodes.reserve(count);
+}
+
+template <class Action>
+void AvlTree::traverse_level_order(Action action, unsigned threads_count)
+{
+	traverse_nodes_level_order(nodes, root, action, threads_count);
+}
+
+void AvlTree::add(int value)
+{
+	const node_index added = static_cast<node_index>(nodes.size());
+	nodes.emplace_back(value);
+	if (root == no_node)
+	{
+		root = added;
 		return;
-	std::queue<BinaryTreeNode*> nodes;
-	nodes.push(root);
-	while (!nodes.empty())
-	{
-		auto node = nodes.front();
-		nodes.pop();
-		BinaryTreeNode* left = node->left;
-		BinaryTreeNode* right = node->right;
-		action(node);
-		if (left)
-			nodes.push(left);
-		if (right)
-			nodes.push(right);
+	}
+	node_index path[max_height];
+	int depth = 0;
+	node_index node = root;
+	while (true)
+	{
+		path[depth++] = node;
+		node_index& child = nodes[node].value <= value ? nodes[node].right : nodes[node].left;
+		if (child == no_node)
+		{
+			child = added;
+			break;
+		}
+		node = child;
+	}
+	// Поднимаемся к корню, пересчитывая высоты. Как только высота поддерева не изменилась, выше ничего не меняется
+	for (int i = depth - 1; i >= 0; --i)
+	{
+		const node_index current = path[i];
+		const int old_height = nodes[current].height;
+		const node_index balanced = balance(current);
+		if (i == 0)
+			root = balanced;
+		else if (nodes[path[i - 1]].left == current)
+			nodes[path[i - 1]].left = balanced;
+		else
+			nodes[path[i - 1]].right = balanced;
+		if (nodes[balanced].height == old_height)
+			break;
 	}
 }
 
-int main()
+// Узлы кладутся в массив в порядке возрастания, корень поддерева из отрезка [begin, end) - его середина.
+// Высота поддерева из m узлов при таком делении равна числу двоичных разрядов m. Отрезки обходятся по явному стеку
+void AvlTree::build_from_sorted(const int* values, int n)
 {
-	std::ios_base::sync_with_stdio(false);
-	std::cin.tie(nullptr);
+	nodes.clear();
+	nodes.reserve(n);
+	for (int i = 0; i < n; ++i)
+		nodes.emplace_back(values[i]);
 
-	int n = 0;
-	std::cin >> n;
+	struct Range
+	{
+		int begin;
+		int end;
+		node_index* link; // Поле родителя, в которое записывается корень отрезка
+	};
+	std::vector<Range> ranges;
+	ranges.push_back(Range{ 0, n, &root });
+	while (!ranges.empty())
+	{
+		const Range range = ranges.back();
+		ranges.pop_back();
+		if (range.begin == range.end)
+		{
+			*range.link = no_node;
+			continue;
+		}
+		const int middle = range.begin + (range.end - range.begin) / 2;
+		AvlTreeNode& node = nodes[middle];
+		*range.link = static_cast<node_index>(middle);
+		uint8_t height = 0;
+		for (unsigned size = static_cast<unsigned>(range.end - range.begin); size > 0; size >>= 1)
+			++height;
+		node.height = height;
+		ranges.push_back(Range{ range.begin, middle, &node.left });
+		ranges.push_back(Range{ middle + 1, range.end, &node.right });
+	}
+}
 
-	BinaryTree tree;
+int AvlTree::height(node_index node) const
+{
+	return node == no_node ? 0 : nodes[node].height;
+}
+
+int AvlTree::balance_factor(node_index node) const
+{
+	return height(nodes[node].right) - height(nodes[node].left);
+}
+
+void AvlTree::fix_height(node_index node)
+{
+	nodes[node].height = static_cast<uint8_t>(std::max(height(nodes[node].left), height(nodes[node].right)) + 1);
+}
+
+node_index AvlTree::rotate_right(node_index node)
+{
+	const node_index left = nodes[node].left;
+	nodes[node].left = nodes[left].right;
+	nodes[left].right = node;
+	fix_height(node);
+	fix_height(left);
+	return left;
+}
+
+node_index AvlTree::rotate_left(node_index node)
+{
+	const node_index right = nodes[node].right;
+	nodes[node].right = nodes[right].left;
+	nodes[right].left = node;
+	fix_height(node);
+	fix_height(right);
+	return right;
+}
+
+node_index AvlTree::balance(node_index node)
+{
+	fix_height(node);
+	const int factor = balance_factor(node);
+	if (factor == 2)
+	{
+		if (balance_factor(nodes[node].right) < 0)
+			nodes[node].right = rotate_right(nodes[node].right);
+		return rotate_left(node);
+	}
+	if (factor == -2)
+	{
+		if (balance_factor(nodes[node].left) > 0)
+			nodes[node].left = rotate_left(nodes[node].left);
+		return rotate_right(node);
+	}
+	return node;
+}
+
+// Время построения наивного и АВЛ-дерева из n отсортированных и n случайных чисел, и построения из отсортированного массива
+void run_benchmark(int n)
+{
+	std::mt19937 generator(42);
+	std::vector<int> sorted(n);
+	for (int i = 0; i < n; ++i)
+		sorted[i] = i;
+	std::vector<int> shuffled = sorted;
+	std::shuffle(shuffled.begin(), shuffled.end(), generator);
 
-	auto print_node_value = [](BinaryTreeNode* node)
+	// Время выполнения build в миллисекундах
+	const auto measure = [](auto build)
 	{
-		std::cout << node->value << " ";
+		const auto start_time = std::chrono::steady_clock::now();
+		build();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+		return elapsed.count();
 	};
+	std::cout << "input\tnaive ms\tavl ms\tbuild_from_sorted ms\n";
+	for (const std::vector<int>* input : { &sorted, &shuffled })
+	{
+		const double naive_time = measure([&]
+		{
+			BinaryTree tree;
+			tree.reserve(n);
+			for (const int value : *input)
+				tree.add(value);
+		});
+		const double avl_time = measure([&]
+		{
+			AvlTree tree;
+			tree.reserve(n);
+			for (const int value : *input)
+				tree.add(value);
+		});
+		std::cout << (input == &sorted ? "sorted" : "random") << "\t" << naive_time << "\t" << avl_time;
+		if (input == &sorted)
+			std::cout << "\t" << measure([&] { AvlTree tree; tree.build_from_sorted(sorted.data(), n); });
+		std::cout << "\n";
+	}
+}
 
+// Время обхода level-order идеально сбалансированного дерева из n узлов в 1..2*hardware_concurrency потоков.
+// Нижние слои такого дерева содержат до n / 2 узлов
+void run_traversal_benchmark(int n)
+{
+	std::vector<int> sorted(n);
 	for (int i = 0; i < n; ++i)
+		sorted[i] = i;
+	AvlTree tree;
+	tree.build_from_sorted(sorted.data(), n);
+
+	const unsigned max_threads = std::max(2u, 2 * std::thread::hardware_concurrency());
+	std::cout << "threads\tms\tchecksum\n";
+	for (unsigned threads_count = 1; threads_count <= max_threads; threads_count *= 2)
+	{
+		// Контрольная сумма зависит от порядка узлов и должна совпадать для любого числа потоков
+		unsigned long long checksum = 0;
+		const auto start_time = std::chrono::steady_clock::now();
+		tree.traverse_level_order([&checksum](const AvlTreeNode& node)
+		{
+			checksum = checksum * 31 + static_cast<unsigned>(node.value);
+		}, threads_count);
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+		std::cout << threads_count << "\t" << elapsed.count() << "\t" << checksum << "\n";
+	}
+}
+
+// --balanced строит АВЛ-дерево (из отсортированной последовательности - сразу идеально сбалансированное)
+// вместо наивного, --benchmark [n] и --traversal-benchmark [n] запускают замеры
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
 	{
-		int value = 0;
-		std::cin >> value;
-		tree.add(value);
+		run_benchmark(argc > 2 ? std::atoi(argv[2]) : 100000);
+		return 0;
 	}
+	if (argc > 1 && std::strcmp(argv[1], "--traversal-benchmark") == 0)
+	{
+		run_traversal_benchmark(argc > 2 ? std::atoi(argv[2]) : 1 << 22);
+		return 0;
+	}
+	const bool balanced = argc > 1 && std::strcmp(argv[1], "--balanced") == 0;
 
-	tree.traverse_level_order(print_node_value);
+	IntegerReader reader(stdin);
+	long long n = 0;
+	reader.next(n);
+	n = std::max(0LL, n); // Отрицательное количество - пустое дерево
+	const auto read_value = [&reader]()
+	{
+		long long value = 0;
+		reader.next(value);
+		return static_cast<int>(value);
+	};
+
+	const unsigned threads_count = parallel::default_threads_count();
+	BufferedWriter writer(stdout);
+	const auto print_node_value = [&writer](const auto& node)
+	{
+		writer.write(node.value);
+	};
+	if (balanced)
+	{
+		// Числа читаются целиком, чтобы отсортированный ввод строить без поворотов
+		std::vector<int> values(static_cast<size_t>(n));
+		for (int& value : values)
+			value = read_value();
+		AvlTree tree;
+		if (std::is_sorted(values.begin(), values.end()))
+		{
+			tree.build_from_sorted(values.data(), static_cast<int>(n));
+		}
+		else
+		{
+			tree.reserve(static_cast<int>(n));
+			for (const int value : values)
+				tree.add(value);
+		}
+		tree.traverse_level_order(print_node_value, threads_count);
+		return 0;
+	}
 
-	std::cout.flush();
+	BinaryTree tree;
+	tree.reserve(static_cast<int>(n));
+	for (long long i = 0; i < n; ++i)
+		tree.add(read_value());
+	tree.traverse_level_order(print_node_value, threads_count);
 	return 0;
 }
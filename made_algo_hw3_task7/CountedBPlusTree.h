@@ -0,0 +1,362 @@
+﻿#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+constexpr int bplus_tree_order = 64; // Наибольшее число значений в листе и потомков во внутреннем узле
+
+// Мультимножество целых чисел на B+-дереве, внутренние узлы которого хранят размеры поддеревьев потомков.
+// Интерфейс совпадает с Treap. Значения лежат в листах плотными отсортированными массивами, поэтому спуск
+// от корня к листу касается O(log_64 n) узлов вместо O(log n) узлов декартова дерева, а поиск внутри узла
+// идёт по последовательной памяти. В отличие от FenwickRankSet, набор значений заранее знать не нужно.
+// Операции итеративные: пройденные узлы запоминаются в стеке path.
+// Переполненный узел делится пополам. Узел, в котором осталось меньше четверти от bplus_tree_order записей,
+// сливается с соседом, если их записи помещаются в один узел, а опустевший узел удаляется
+class CountedBPlusTree
+{
+public:
+	CountedBPlusTree();
+
+	// Добавляет value и возвращает количество элементов, строго больших value
+	int add(int value);
+	// Удаляет все элементы, равные value
+	void remove(int value);
+	// Удаляет элемент, стоящий в позиции k при сортировке по возрастанию, и возвращает его значение
+	int remove_k_order_statistic(int k);
+	// Значение элемента, стоящего в позиции k при сортировке по возрастанию
+	int get_k_order_statistic(int k) const;
+	// Количество элементов
+	int size() const;
+
+private:
+	typedef uint32_t node_index;
+
+	struct Leaf
+	{
+		int count = 0;
+		int values[bplus_tree_order];
+	};
+
+	// Все значения потомка i не меньше keys[i] и не больше keys[i + 1]; keys[0] не используется
+	struct InnerNode
+	{
+		int count = 0;
+		int keys[bplus_tree_order];
+		int sizes[bplus_tree_order]; // Количество значений в поддереве потомка
+		node_index children[bplus_tree_order]; // Листы на нижнем уровне внутренних узлов, иначе внутренние узлы
+	};
+
+	struct PathEntry
+	{
+		node_index node;
+		int child;
+	};
+
+	std::vector<Leaf> leaves;
+	std::vector<InnerNode> inner_nodes;
+	std::vector<node_index> free_leaves;
+	std::vector<node_index> free_inner_nodes;
+	std::vector<PathEntry> path;
+	node_index root;
+	int height = 0; // Количество уровней внутренних узлов; при нуле корень - лист
+	int total = 0;
+
+	node_index create_leaf();
+	node_index create_inner_node();
+	// Количество элементов, строго меньших value
+	int count_less(int value) const;
+	// Вставляет в узел node запись (key, size, child) в позицию position
+	static void insert_entry(InnerNode& node, int position, int key, int size, node_index child);
+	// Удаляет из узла node запись в позиции position
+	static void erase_entry(InnerNode& node, int position);
+	// Вставляет в родителей узлов из стека path правый узел right, отделившийся от узла на вершине стека
+	void insert_into_parents(int key, node_index right, int left_size, int right_size);
+	// Сливает или удаляет недозаполненные узлы снизу вверх по стеку path, начиная с листа leaf
+	void rebalance_after_erase(node_index leaf);
+};
+
+inline CountedBPlusTree::CountedBPlusTree()
+{
+	root = create_leaf();
+}
+
+inline CountedBPlusTree::node_index CountedBPlusTree::create_leaf()
+{
+	if (!free_leaves.empty())
+	{
+		const node_index leaf = free_leaves.back();
+		free_leaves.pop_back();
+		leaves[leaf].count = 0;
+		return leaf;
+	}
+	leaves.emplace_back();
+	return static_cast<node_index>(leaves.size() - 1);
+}
+
+inline CountedBPlusTree::node_index CountedBPlusTree::create_inner_node()
+{
+	if (!free_inner_nodes.empty())
+	{
+		const node_index node = free_inner_nodes.back();
+		free_inner_nodes.pop_back();
+		inner_nodes[node].count = 0;
+		return node;
+	}
+	inner_nodes.emplace_back();
+	return static_cast<node_index>(inner_nodes.size() - 1);
+}
+
+inline void CountedBPlusTree::insert_entry(InnerNode& node, int position, int key, int size, node_index child)
+{
+	std::copy_backward(node.keys + position, node.keys + node.count, node.keys + node.count + 1);
+	std::copy_backward(node.sizes + position, node.sizes + node.count, node.sizes + node.count + 1);
+	std::copy_backward(node.children + position, node.children + node.count, node.children + node.count + 1);
+	node.keys[position] = key;
+	node.sizes[position] = size;
+	node.children[position] = child;
+	++node.count;
+}
+
+inline void CountedBPlusTree::erase_entry(InnerNode& node, int position)
+{
+	std::copy(node.keys + position + 1, node.keys + node.count, node.keys + position);
+	std::copy(node.sizes + position + 1, node.sizes + node.count, node.sizes + position);
+	std::copy(node.children + position + 1, node.children + node.count, node.children + position);
+	--node.count;
+}
+
+// Спускаемся к листу, где value встанет после равных ему, по пути складывая размеры поддеревьев правее пути
+inline int CountedBPlusTree::add(int value)
+{
+	int greater_elements_count = 0;
+	node_index node = root;
+	for (int level = 0; level < height; ++level)
+	{
+		InnerNode& inner = inner_nodes[node];
+		const int child = static_cast<int>(std::upper_bound(inner.keys + 1, inner.keys + inner.count, value) - inner.keys) - 1;
+		for (int i = child + 1; i < inner.count; ++i)
+			greater_elements_count += inner.sizes[i];
+		++inner.sizes[child];
+		path.push_back(PathEntry{ node, child });
+		node = inner.children[child];
+	}
+	++total;
+
+	const int position = static_cast<int>(std::upper_bound(leaves[node].values, leaves[node].values + leaves[node].count, value)
+		- leaves[node].values);
+	greater_elements_count += leaves[node].count - position;
+	if (leaves[node].count < bplus_tree_order)
+	{
+		Leaf& leaf = leaves[node];
+		std::copy_backward(leaf.values + position, leaf.values + leaf.count, leaf.values + leaf.count + 1);
+		leaf.values[position] = value;
+		++leaf.count;
+		path.clear();
+		return greater_elements_count;
+	}
+
+	// Верхняя половина переполненного листа переезжает в новый лист, value вставляется в свою половину
+	const node_index right = create_leaf();
+	Leaf& left_leaf = leaves[node];
+	Leaf& right_leaf = leaves[right];
+	const int half = bplus_tree_order / 2;
+	std::copy(left_leaf.values + half, left_leaf.values + bplus_tree_order, right_leaf.values);
+	right_leaf.count = bplus_tree_order - half;
+	left_leaf.count = half;
+	Leaf& target = position <= half ? left_leaf : right_leaf;
+	const int target_position = position <= half ? position : position - half;
+	std::copy_backward(target.values + target_position, target.values + target.count, target.values + target.count + 1);
+	target.values[target_position] = value;
+	++target.count;
+	insert_into_parents(right_leaf.values[0], right, left_leaf.count, right_leaf.count);
+	return greater_elements_count;
+}
+
+inline void CountedBPlusTree::insert_into_parents(int key, node_index right, int left_size, int right_size)
+{
+	while (!path.empty())
+	{
+		const PathEntry entry = path.back();
+		path.pop_back();
+		inner_nodes[entry.node].sizes[entry.child] = left_size;
+		if (inner_nodes[entry.node].count < bplus_tree_order)
+		{
+			insert_entry(inner_nodes[entry.node], entry.child + 1, key, right_size, right);
+			path.clear();
+			return;
+		}
+
+		const node_index right_node = create_inner_node();
+		InnerNode& left_inner = inner_nodes[entry.node];
+		InnerNode& right_inner = inner_nodes[right_node];
+		const int half = bplus_tree_order / 2;
+		std::copy(left_inner.keys + half, left_inner.keys + bplus_tree_order, right_inner.keys);
+		std::copy(left_inner.sizes + half, left_inner.sizes + bplus_tree_order, right_inner.sizes);
+		std::copy(left_inner.children + half, left_inner.children + bplus_tree_order, right_inner.children);
+		right_inner.count = bplus_tree_order - half;
+		left_inner.count = half;
+		const int position = entry.child + 1;
+		if (position <= half)
+			insert_entry(left_inner, position, key, right_size, right);
+		else
+			insert_entry(right_inner, position - half, key, right_size, right);
+
+		key = right_inner.keys[0];
+		right = right_node;
+		left_size = 0;
+		for (int i = 0; i < left_inner.count; ++i)
+			left_size += left_inner.sizes[i];
+		right_size = 0;
+		for (int i = 0; i < right_inner.count; ++i)
+			right_size += right_inner.sizes[i];
+	}
+
+	// Разделился корень: дерево растёт на уровень
+	const node_index new_root = create_inner_node();
+	InnerNode& inner = inner_nodes[new_root];
+	inner.count = 2;
+	inner.children[0] = root;
+	inner.sizes[0] = left_size;
+	inner.children[1] = right;
+	inner.sizes[1] = right_size;
+	inner.keys[1] = key;
+	root = new_root;
+	++height;
+}
+
+inline int CountedBPlusTree::count_less(int value) const
+{
+	int less_elements_count = 0;
+	node_index node = root;
+	for (int level = 0; level < height; ++level)
+	{
+		const InnerNode& inner = inner_nodes[node];
+		const int child = static_cast<int>(std::lower_bound(inner.keys + 1, inner.keys + inner.count, value) - inner.keys) - 1;
+		for (int i = 0; i < child; ++i)
+			less_elements_count += inner.sizes[i];
+		node = inner.children[child];
+	}
+	const Leaf& leaf = leaves[node];
+	return less_elements_count + static_cast<int>(std::lower_bound(leaf.values, leaf.values + leaf.count, value) - leaf.values);
+}
+
+inline void CountedBPlusTree::remove(int value)
+{
+	const int position = count_less(value);
+	while (position < total && get_k_order_statistic(position) == value)
+		remove_k_order_statistic(position);
+}
+
+inline int CountedBPlusTree::remove_k_order_statistic(int k)
+{
+	assert(k >= 0 && k < total);
+	node_index node = root;
+	for (int level = 0; level < height; ++level)
+	{
+		InnerNode& inner = inner_nodes[node];
+		int child = 0;
+		while (k >= inner.sizes[child])
+			k -= inner.sizes[child++];
+		--inner.sizes[child];
+		path.push_back(PathEntry{ node, child });
+		node = inner.children[child];
+	}
+	--total;
+
+	Leaf& leaf = leaves[node];
+	const int value = leaf.values[k];
+	std::copy(leaf.values + k + 1, leaf.values + leaf.count, leaf.values + k);
+	--leaf.count;
+	rebalance_after_erase(node);
+	return value;
+}
+
+inline void CountedBPlusTree::rebalance_after_erase(node_index leaf)
+{
+	node_index node = leaf;
+	bool is_leaf = true;
+	while (!path.empty())
+	{
+		const int count = is_leaf ? leaves[node].count : inner_nodes[node].count;
+		if (count >= bplus_tree_order / 4)
+			break;
+		const PathEntry entry = path.back();
+		path.pop_back();
+		InnerNode& parent = inner_nodes[entry.node];
+		if (count == 0)
+		{
+			(is_leaf ? free_leaves : free_inner_nodes).push_back(node);
+			erase_entry(parent, entry.child);
+		}
+		else if (parent.count > 1)
+		{
+			// Сливаем с соседом: правый из пары дописывается в левый
+			const int left_child = entry.child > 0 ? entry.child - 1 : 0;
+			const int right_child = left_child + 1;
+			const node_index left = parent.children[left_child];
+			const node_index right = parent.children[right_child];
+			if (is_leaf)
+			{
+				Leaf& left_leaf = leaves[left];
+				const Leaf& right_leaf = leaves[right];
+				if (left_leaf.count + right_leaf.count > bplus_tree_order)
+					break;
+				std::copy(right_leaf.values, right_leaf.values + right_leaf.count, left_leaf.values + left_leaf.count);
+				left_leaf.count += right_leaf.count;
+				free_leaves.push_back(right);
+			}
+			else
+			{
+				InnerNode& left_inner = inner_nodes[left];
+				InnerNode& right_inner = inner_nodes[right];
+				if (left_inner.count + right_inner.count > bplus_tree_order)
+					break;
+				right_inner.keys[0] = parent.keys[right_child];
+				std::copy(right_inner.keys, right_inner.keys + right_inner.count, left_inner.keys + left_inner.count);
+				std::copy(right_inner.sizes, right_inner.sizes + right_inner.count, left_inner.sizes + left_inner.count);
+				std::copy(right_inner.children, right_inner.children + right_inner.count, left_inner.children + left_inner.count);
+				left_inner.count += right_inner.count;
+				free_inner_nodes.push_back(right);
+			}
+			parent.sizes[left_child] += parent.sizes[right_child];
+			erase_entry(parent, right_child);
+		}
+		else
+		{
+			break;
+		}
+		node = entry.node;
+		is_leaf = false;
+	}
+	path.clear();
+
+	// Корень с единственным потомком не нужен: дерево становится на уровень ниже
+	while (height > 0 && inner_nodes[root].count == 1)
+	{
+		free_inner_nodes.push_back(root);
+		root = inner_nodes[root].children[0];
+		--height;
+	}
+}
+
+inline int CountedBPlusTree::get_k_order_statistic(int k) const
+{
+	assert(k >= 0 && k < total);
+	node_index node = root;
+	for (int level = 0; level < height; ++level)
+	{
+		const InnerNode& inner = inner_nodes[node];
+		int child = 0;
+		while (k >= inner.sizes[child])
+			k -= inner.sizes[child++];
+		node = inner.children[child];
+	}
+	return leaves[node].values[k];
+}
+
+inline int CountedBPlusTree::size() const
+{
+	return total;
+}
@@ -0,0 +1,125 @@
+﻿#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+// Мультимножество целых чисел из заранее известного набора universe (например, всех значений команд,
+// прочитанных до их выполнения) на дереве Фенвика над счётчиками значений.
+// Интерфейс совпадает с Treap: добавление с подсчётом больших элементов, удаление, поиск и удаление k-й статистики.
+// Все операции - O(log n) по размеру набора без указателей: один массив счётчиков и один массив частичных сумм.
+// k-я статистика ищется спуском по степеням двойки (binary lifting) за один проход по дереву
+class FenwickRankSet
+{
+public:
+	// universe - все значения, которые будут добавляться, в любом порядке и с повторами
+	explicit FenwickRankSet(std::vector<int> universe);
+
+	// Добавляет value и возвращает количество элементов, строго больших value. value должен входить в набор
+	int add(int value);
+	// Удаляет все элементы, равные value
+	void remove(int value);
+	// Удаляет элемент, стоящий в позиции k при сортировке по возрастанию, и возвращает его значение
+	int remove_k_order_statistic(int k);
+	// Значение элемента, стоящего в позиции k при сортировке по возрастанию
+	int get_k_order_statistic(int k) const;
+	// Количество элементов
+	int size() const;
+
+private:
+	std::vector<int> values; // Отсортированный набор без повторов
+	std::vector<int> counts; // Количество элементов, равных values[i]
+	std::vector<int> tree; // tree[i] - сумма counts на (i - (i & -i), i], нумерация с единицы
+	int highest_step = 0; // Наибольшая степень двойки, не превосходящая values.size()
+	int total = 0;
+
+	// Индекс value в values
+	int index_of(int value) const;
+	// Прибавляет delta к счётчику index
+	void update(int index, int delta);
+	// Количество элементов, не больших values[index]
+	int prefix_count(int index) const;
+	// Индекс k-го по возрастанию элемента в values
+	int find_k(int k) const;
+};
+
+inline FenwickRankSet::FenwickRankSet(std::vector<int> universe) : values(std::move(universe))
+{
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+	counts.assign(values.size(), 0);
+	tree.assign(values.size() + 1, 0);
+	highest_step = 1;
+	while (highest_step * 2 <= static_cast<int>(values.size()))
+		highest_step *= 2;
+}
+
+inline int FenwickRankSet::index_of(int value) const
+{
+	const int index = static_cast<int>(std::lower_bound(values.begin(), values.end(), value) - values.begin());
+	assert(index < static_cast<int>(values.size()) && values[index] == value);
+	return index;
+}
+
+inline void FenwickRankSet::update(int index, int delta)
+{
+	counts[index] += delta;
+	total += delta;
+	for (int i = index + 1; i < static_cast<int>(tree.size()); i += i & -i)
+		tree[i] += delta;
+}
+
+inline int FenwickRankSet::prefix_count(int index) const
+{
+	int count = 0;
+	for (int i = index + 1; i > 0; i -= i & -i)
+		count += tree[i];
+	return count;
+}
+
+// Ищем наибольшую позицию, сумма до которой не больше k: следующий за ней индекс и есть ответ
+inline int FenwickRankSet::find_k(int k) const
+{
+	assert(k >= 0 && k < total);
+	int position = 0;
+	for (int step = highest_step; step > 0; step >>= 1)
+	{
+		if (position + step < static_cast<int>(tree.size()) && tree[position + step] <= k)
+		{
+			position += step;
+			k -= tree[position];
+		}
+	}
+	return position;
+}
+
+inline int FenwickRankSet::add(int value)
+{
+	const int index = index_of(value);
+	const int greater_elements_count = total - prefix_count(index);
+	update(index, 1);
+	return greater_elements_count;
+}
+
+inline void FenwickRankSet::remove(int value)
+{
+	const int index = index_of(value);
+	update(index, -counts[index]);
+}
+
+inline int FenwickRankSet::remove_k_order_statistic(int k)
+{
+	const int index = find_k(k);
+	update(index, -1);
+	return values[index];
+}
+
+inline int FenwickRankSet::get_k_order_statistic(int k) const
+{
+	return values[find_k(k)];
+}
+
+inline int FenwickRankSet::size() const
+{
+	return total;
+}
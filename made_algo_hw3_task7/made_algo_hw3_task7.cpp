@@ -7,192 +7,902 @@
 // а именно для каждого приходящего солдата указывать, перед каким солдатом в строе он должен становиться.
 // Вариант 7_1. Требуемая скорость выполнения команды - O(log n) в среднем. В реализации используйте декартово дерево.
 //
+#include "CountedBPlusTree.h"
+#include "FenwickRankSet.h"
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Индекс узла в массиве узлов дерева. 32 бит хватает на любое число команд и вдвое меньше указателя
+typedef uint32_t node_index;
+// Отсутствующий потомок
+constexpr node_index no_node = UINT32_MAX;
 
 // Узел декартова дерева.
 struct TreapNode
 {
-	explicit TreapNode(int _value) :
-		value(_value), priority(rand())
+	TreapNode(int _value, uint32_t _priority) :
+		value(_value), priority(_priority)
 	{
 	}
 
 	int value;
-	int priority;
+	uint32_t priority;
 	int subtree_size = 1; // Размер поддерева с корнем в данном узле
-	TreapNode* left = nullptr;
-	TreapNode* right = nullptr;
+	node_index left = no_node;
+	node_index right = no_node;
 };
 
-// Декартово дерево
+static_assert(sizeof(TreapNode) == 20, "TreapNode must stay compact");
+
+constexpr int lookahead_count = 32; // Опережающих спусков в пакетных операциях - больше средней глубины дерева из 10^6 узлов
+constexpr int lookahead_min_size = 1 << 18; // Меньшее дерево помещается в кэш, и опережающие спуски не нужны
+constexpr int lookahead_min_gap = 64; // Наименьшее среднее число элементов дерева между соседними элементами пакета
+
+// Декартово дерево. Узлы лежат в одном массиве и ссылаются друг на друга индексами, удалённые узлы
+// переиспользуются через список свободных, поэтому операции не выделяют память, а дерево освобождается целиком.
+// Приоритеты берутся из собственного генератора xorshift каждого дерева. Операции над одним путём итеративные:
+// узлы, у которых меняется размер поддерева, запоминаются в стеке path и пересчитываются снизу вверх
 class Treap
 {
 public:
-	~Treap();
+	explicit Treap(uint32_t seed = 42);
+
+	// Выделяет память сразу под count узлов
+	void reserve(int count);
 
 	int add(int value);
 
 	void remove(int value);
 
+	// Удаляет элемент, стоящий в позиции k при сортировке по возрастанию, и возвращает его значение
+	int remove_k_order_statistic(int k);
+
 	int get_k_order_statistic(int k) const;
 
 	int size() const;
 
+	// Заменяет содержимое дерева n числами values, отсортированными по возрастанию, за O(n)
+	void build_from_sorted(const int* values, int n);
+
+	// Добавляет count чисел values в любом порядке; неотсортированный пакет сортируется в копии.
+	// Элементы вставляются по возрастанию, и поиск места каждого начинается не с корня, а с пути предыдущего:
+	// O(count * log(n / count + 1)) в среднем. В большом дереве пути следующих элементов загружаются в кэш заранее
+	void insert_batch(const int* values, int count);
+
+	// Удаляет все элементы, равные какому-либо из count чисел values. Поиск устроен, как в insert_batch
+	void erase_batch(const int* values, int count);
+
+	// Оставляет в дереве k наименьших элементов и возвращает дерево из остальных.
+	// Части хранятся в разных массивах узлов, поэтому меньшая из них копируется: O(log n + min(k, n - k))
+	Treap split_by_rank(int k);
+
+	// Переносит в конец дерева все элементы other, которые должны быть не меньше элементов дерева.
+	// Узлы меньшего из деревьев копируются к узлам большего: O(log n + min(n, other.size()))
+	void concat(Treap& other);
+
 private:
-	TreapNode* root = nullptr;
+	std::vector<TreapNode> nodes;
+	std::vector<node_index> free_nodes; // Индексы удалённых узлов
+	std::vector<node_index> path; // Стек узлов, размеры которых надо пересчитать, - общий для всех операций
+	node_index root = no_node;
+	uint32_t random_state;
+
+	// Узел пути пакетной операции. Следующий по возрастанию элемент пакета ищется не от корня, а от ближайшего узла пути,
+	// в поддерево которого он попадает. Спуск от корня уходит из этого поддерева на значениях от upper и больше.
+	// size_change - изменение размера поддерева, ещё не записанное в узел
+	struct FingerEntry
+	{
+		node_index node;
+		int64_t upper;
+		int size_change;
+	};
+
+	// Опережающий спуск к значению одного из следующих элементов пакета
+	struct Lookahead
+	{
+		node_index node;
+		int value;
+	};
+
+	node_index create_node(int value);
+	void free_node(node_index node);
+	uint32_t next_priority();
+
+	// Возвращает корень дерева из n отсортированных чисел values. Правая граница дерева хранится в стеке path
+	node_index build(const int* values, int n);
+
+	// Переносит копию поддерева node дерева source в массив узлов этого дерева, освобождая узлы в source
+	node_index move_subtree(Treap& source, node_index node);
+
+	// Вставляет отдельный узел added в поддерево subtree и возвращает количество элементов поддерева, строго больших его значения
+	int insert_node(node_index& subtree, node_index added);
+
+	std::pair<node_index, node_index> split(node_index node, int value, bool equal_to_left = true);
+
+	// Разделяет поддерево node на k наименьших элементов и остальные
+	std::pair<node_index, node_index> split_by_rank(node_index node, int k);
 
-	static void delete_subtree(TreapNode* node);
+	// Снимает верхний узел пути, записывая в него накопленное изменение размера и передавая это изменение родителю
+	void pop_finger(std::vector<FingerEntry>& finger);
 
-	static std::pair<TreapNode*, TreapNode*> split(TreapNode* node, int value);
-	
-	static TreapNode* merge(TreapNode* left, TreapNode* right);
+	// Нужны ли опережающие спуски для пакета из count элементов
+	bool needs_lookahead(int count) const;
 
-	static int get_size(TreapNode* node);
+	// Сдвигает cursors[index % lookahead_count] на элемент index + lookahead_count пакета values из count элементов
+	// и продвигает каждый опережающий спуск на уровень вниз
+	void advance_lookahead(std::vector<Lookahead>& cursors, const int* values, int count, int index) const;
 
-	static int get_k_order_statistic(TreapNode* node, int k);
-	
+	node_index merge(node_index left, node_index right);
+
+	// Пересчитывает размеры поддеревьев узлов из стека path, начиная с верхнего, и очищает стек
+	void update_path_sizes();
+
+	int get_size(node_index node) const;
+
+	void update_size(node_index node);
 };
 
-// Разделяет поддерево node на два: в первом значения не превосходят value, во втором строго больше
-std::pair<TreapNode*, TreapNode*> Treap::split(TreapNode* node, int value)
+Treap::Treap(uint32_t seed) : random_state(seed != 0 ? seed : 1)
+{
+}
+
+void Treap::reserve(int count)
+{
+	nodes.reserve(count);
+}
+
+// xorshift32: период 2^32 - 1, на порядок быстрее rand() и не зависит от других деревьев
+uint32_t Treap::next_priority()
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+node_index Treap::create_node(int value)
 {
-	if (!node)
+	const uint32_t priority = next_priority();
+	if (!free_nodes.empty())
 	{
-		return std::make_pair(static_cast<TreapNode*>(nullptr), static_cast<TreapNode*>(nullptr));
+		const node_index node = free_nodes.back();
+		free_nodes.pop_back();
+		nodes[node] = TreapNode(value, priority);
+		return node;
 	}
-	if (node->value <= value) // Левое поддерево не изменится
+	nodes.emplace_back(value, priority);
+	return static_cast<node_index>(nodes.size() - 1);
+}
+
+void Treap::free_node(node_index node)
+{
+	free_nodes.push_back(node);
+}
+
+// Разделяет поддерево node на два: в первом значения не превосходят value, во втором строго больше
+// (при equal_to_left == false в первом значения строго меньше value).
+// Спускаемся по дереву, подвешивая пройденные узлы к правому краю левой части или к левому краю правой
+std::pair<node_index, node_index> Treap::split(node_index node, int value, bool equal_to_left)
+{
+	node_index left_root = no_node;
+	node_index right_root = no_node;
+	node_index* left_link = &left_root;
+	node_index* right_link = &right_root;
+	while (node != no_node)
 	{
-		const auto right_pair = split(node->right, value);
-		node->right = right_pair.first;
-		node->subtree_size = get_size(node);
-		return std::make_pair(node, right_pair.second);
+		path.push_back(node);
+		if (nodes[node].value < value || (equal_to_left && nodes[node].value == value)) // Левое поддерево не изменится
+		{
+			*left_link = node;
+			left_link = &nodes[node].right;
+			node = nodes[node].right;
+		}
+		else // Правое поддерево не изменится
+		{
+			*right_link = node;
+			right_link = &nodes[node].left;
+			node = nodes[node].left;
+		}
 	}
-	else // Правое поддерево не изменится
+	*left_link = no_node;
+	*right_link = no_node;
+	update_path_sizes();
+	return std::make_pair(left_root, right_root);
+}
+
+std::pair<node_index, node_index> Treap::split_by_rank(node_index node, int k)
+{
+	node_index left_root = no_node;
+	node_index right_root = no_node;
+	node_index* left_link = &left_root;
+	node_index* right_link = &right_root;
+	while (node != no_node)
 	{
-		const auto left_pair = split(node->left, value);		
-		node->left = left_pair.second;
-		node->subtree_size = get_size(node);
-		return std::make_pair(left_pair.first, node);
+		path.push_back(node);
+		const int left_size = get_size(nodes[node].left);
+		if (left_size < k) // Узел и его левое поддерево попадают в первую часть
+		{
+			k -= left_size + 1;
+			*left_link = node;
+			left_link = &nodes[node].right;
+			node = nodes[node].right;
+		}
+		else
+		{
+			*right_link = node;
+			right_link = &nodes[node].left;
+			node = nodes[node].left;
+		}
 	}
+	*left_link = no_node;
+	*right_link = no_node;
+	update_path_sizes();
+	return std::make_pair(left_root, right_root);
 }
 
 // Сливает два дерева left и right в одно
 // предполагается, что все ключи в left не превышают ключей в right
-TreapNode* Treap::merge(TreapNode* left, TreapNode* right)
+node_index Treap::merge(node_index left, node_index right)
 {
-	if (!left) return right;
-	if (!right) return left;
+	node_index result = no_node;
+	node_index* link = &result;
+	while (left != no_node && right != no_node)
+	{
+		if (nodes[right].priority < nodes[left].priority) // Корнем станет left, т.к. у него наивысший приоритет
+		{
+			*link = left;
+			path.push_back(left);
+			link = &nodes[left].right;
+			left = nodes[left].right;
+		}
+		else
+		{
+			*link = right;
+			path.push_back(right);
+			link = &nodes[right].left;
+			right = nodes[right].left;
+		}
+	}
+	*link = left != no_node ? left : right;
+	update_path_sizes();
+	return result;
+}
 
-	if (right->priority < left->priority) // Новым корнем станет left, т.к. у него наивысший приоритет
+void Treap::update_path_sizes()
+{
+	while (!path.empty())
 	{
-		left->right = merge(left->right, right);
-		left->subtree_size = get_size(left);
-		return left;
+		update_size(path.back());
+		path.pop_back();
 	}
-	else
+}
+
+// Корень поддерева - узел с наибольшим приоритетом. Узлы добавляются по возрастанию значений на правую границу:
+// новый узел забирает в левое поддерево часть границы с меньшими приоритетами, и поддеревья снятых с границы узлов
+// больше не меняются, поэтому их размеры пересчитываются сразу
+node_index Treap::build(const int* values, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		const node_index node = create_node(values[i]);
+		node_index last_removed = no_node;
+		while (!path.empty() && nodes[path.back()].priority < nodes[node].priority)
+		{
+			last_removed = path.back();
+			path.pop_back();
+			update_size(last_removed);
+		}
+		nodes[node].left = last_removed;
+		if (!path.empty())
+			nodes[path.back()].right = node;
+		path.push_back(node);
+	}
+	if (path.empty())
+		return no_node;
+	const node_index result = path.front();
+	update_path_sizes();
+	return result;
+}
+
+void Treap::build_from_sorted(const int* values, int n)
+{
+	nodes.clear();
+	free_nodes.clear();
+	nodes.reserve(n);
+	root = build(values, n);
+}
+
+// Узлы копируются вместе с приоритетами, поэтому форма поддерева сохраняется
+node_index Treap::move_subtree(Treap& source, node_index node)
+{
+	if (node == no_node)
+		return no_node;
+	struct Copy
+	{
+		node_index source_node;
+		node_index parent; // Скопированный родитель или no_node для корня
+		bool is_right;
+	};
+	node_index result = no_node;
+	std::vector<Copy> copies;
+	copies.push_back(Copy{ node, no_node, false });
+	while (!copies.empty())
 	{
-		right->left = merge(left, right->left);
-		right->subtree_size = get_size(right);
-		return right;
+		const Copy copy = copies.back();
+		copies.pop_back();
+		const TreapNode& source_node = source.nodes[copy.source_node];
+		const node_index copied = create_node(source_node.value);
+		nodes[copied].priority = source_node.priority;
+		nodes[copied].subtree_size = source_node.subtree_size;
+		if (copy.parent == no_node)
+			result = copied;
+		else if (copy.is_right)
+			nodes[copy.parent].right = copied;
+		else
+			nodes[copy.parent].left = copied;
+		if (source_node.left != no_node)
+			copies.push_back(Copy{ source_node.left, copied, false });
+		if (source_node.right != no_node)
+			copies.push_back(Copy{ source_node.right, copied, true });
+		source.free_node(copy.source_node);
 	}
+	return result;
 }
 
-Treap::~Treap()
+void Treap::pop_finger(std::vector<FingerEntry>& finger)
 {
-	delete_subtree(root);
+	const FingerEntry top = finger.back();
+	finger.pop_back();
+	nodes[top.node].subtree_size += top.size_change;
+	if (!finger.empty())
+		finger.back().size_change += top.size_change;
 }
 
-void Treap::delete_subtree(TreapNode* node)
+// Опережающие спуски окупаются, только если дерево не помещается в кэш и соседние элементы пакета
+// лежат в нём далеко друг от друга, - иначе их пути и так уже загружены
+bool Treap::needs_lookahead(int count) const
 {
-	if (!node) return;
-	delete_subtree(node->left);
-	delete_subtree(node->right);
-	delete node;
+	return size() >= lookahead_min_size && size() / lookahead_min_gap >= count;
 }
 
-// Добавляет элемент value в дерево и возвращает количество элементов, не превышающих value
+// Спуски независимы друг от друга, поэтому их промахи кэша перекрываются. Спуск начинается за lookahead_count
+// элементов до обработки своего элемента и успевает загрузить его путь целиком
+void Treap::advance_lookahead(std::vector<Lookahead>& cursors, const int* values, int count, int index) const
+{
+	const int ahead = index + lookahead_count;
+	cursors[index % lookahead_count] = ahead < count ? Lookahead{ root, values[ahead] } : Lookahead{ no_node, 0 };
+	for (Lookahead& cursor : cursors)
+	{
+		if (cursor.node == no_node)
+			continue;
+		const TreapNode& node = nodes[cursor.node];
+		if (node.value == cursor.value)
+			cursor.node = no_node;
+		else
+			cursor.node = node.value < cursor.value ? node.right : node.left;
+	}
+}
+
+// Каждый элемент вставляется спуском, как в add, но спуск начинается с ближайшего узла пути предыдущего элемента:
+// его поддерево должно содержать значение, а приоритет - быть не меньше приоритета нового узла.
+// Размеры узлов пути обновляются, когда узел снимается с пути, - по одному разу на пакет
+void Treap::insert_batch(const int* values, int count)
+{
+	std::vector<int> sorted_batch;
+	if (!std::is_sorted(values, values + count))
+	{
+		sorted_batch.assign(values, values + count);
+		std::sort(sorted_batch.begin(), sorted_batch.end());
+		values = sorted_batch.data();
+	}
+	std::vector<FingerEntry> finger;
+	std::vector<Lookahead> cursors(needs_lookahead(count) ? lookahead_count : 0, Lookahead{ no_node, 0 });
+	for (int i = 0; i < count; ++i)
+	{
+		if (!cursors.empty())
+			advance_lookahead(cursors, values, count, i);
+		const int value = values[i];
+		const node_index added = create_node(value);
+		const uint32_t priority = nodes[added].priority;
+		while (!finger.empty() && (value >= finger.back().upper || nodes[finger.back().node].priority < priority))
+			pop_finger(finger);
+		node_index* link = &root;
+		int64_t upper = INT64_MAX;
+		if (!finger.empty())
+		{
+			TreapNode& top = nodes[finger.back().node];
+			upper = top.value <= value ? finger.back().upper : top.value;
+			link = top.value <= value ? &top.right : &top.left;
+		}
+		while (*link != no_node && nodes[*link].priority >= priority)
+		{
+			TreapNode& node = nodes[*link];
+			finger.push_back(FingerEntry{ *link, upper, 0 });
+			if (node.value <= value)
+			{
+				link = &node.right;
+			}
+			else
+			{
+				upper = node.value;
+				link = &node.left;
+			}
+		}
+		const auto pair = split(*link, value);
+		nodes[added].left = pair.first;
+		nodes[added].right = pair.second;
+		update_size(added);
+		*link = added;
+		if (!finger.empty())
+			++finger.back().size_change;
+		finger.push_back(FingerEntry{ added, upper, 0 });
+	}
+	while (!finger.empty())
+		pop_finger(finger);
+}
+
+// Поиск каждого значения, как в remove, начинается с ближайшего узла пути предыдущего значения
+void Treap::erase_batch(const int* values, int count)
+{
+	std::vector<int> sorted_batch;
+	if (!std::is_sorted(values, values + count))
+	{
+		sorted_batch.assign(values, values + count);
+		std::sort(sorted_batch.begin(), sorted_batch.end());
+		values = sorted_batch.data();
+	}
+	std::vector<FingerEntry> finger;
+	std::vector<Lookahead> cursors(needs_lookahead(count) ? lookahead_count : 0, Lookahead{ no_node, 0 });
+	for (int i = 0; i < count; ++i)
+	{
+		if (!cursors.empty())
+			advance_lookahead(cursors, values, count, i);
+		const int value = values[i];
+		// Узел со значением value сам подлежит удалению, поэтому поиск начинается выше него
+		while (!finger.empty() && (value >= finger.back().upper || nodes[finger.back().node].value == value))
+			pop_finger(finger);
+		while (true) // Удаляем все элементы, равные value
+		{
+			node_index* link = &root;
+			int64_t upper = INT64_MAX;
+			if (!finger.empty())
+			{
+				TreapNode& top = nodes[finger.back().node];
+				upper = top.value < value ? finger.back().upper : top.value;
+				link = top.value < value ? &top.right : &top.left;
+			}
+			while (*link != no_node && nodes[*link].value != value)
+			{
+				TreapNode& node = nodes[*link];
+				finger.push_back(FingerEntry{ *link, upper, 0 });
+				if (node.value < value)
+				{
+					link = &node.right;
+				}
+				else
+				{
+					upper = node.value;
+					link = &node.left;
+				}
+			}
+			if (*link == no_node)
+				break;
+			const node_index removed = *link;
+			*link = merge(nodes[removed].left, nodes[removed].right);
+			free_node(removed);
+			if (!finger.empty())
+				--finger.back().size_change;
+		}
+	}
+	while (!finger.empty())
+		pop_finger(finger);
+}
+
+Treap Treap::split_by_rank(int k)
+{
+	const auto pair = split_by_rank(root, k);
+	Treap result(next_priority());
+	// Меньшая часть переезжает в новое дерево, а если это первая часть - деревья затем меняются массивами
+	const bool move_left = get_size(pair.first) < get_size(pair.second);
+	result.nodes.reserve(get_size(move_left ? pair.first : pair.second));
+	result.root = result.move_subtree(*this, move_left ? pair.first : pair.second);
+	root = move_left ? pair.second : pair.first;
+	if (move_left)
+	{
+		std::swap(nodes, result.nodes);
+		std::swap(free_nodes, result.free_nodes);
+		std::swap(root, result.root);
+	}
+	return result;
+}
+
+void Treap::concat(Treap& other)
+{
+	assert(root == no_node || other.root == no_node
+		|| get_k_order_statistic(size() - 1) <= other.get_k_order_statistic(0));
+	if (size() < other.size())
+	{
+		// Копируем себя к узлам other и забираем его массивы
+		other.nodes.reserve(other.nodes.size() + size());
+		const node_index moved = other.move_subtree(*this, root);
+		other.root = other.merge(moved, other.root);
+		std::swap(nodes, other.nodes);
+		std::swap(free_nodes, other.free_nodes);
+		root = other.root;
+	}
+	else
+	{
+		nodes.reserve(nodes.size() + other.size());
+		root = merge(root, move_subtree(other, other.root));
+	}
+	other.nodes.clear();
+	other.free_nodes.clear();
+	other.root = no_node;
+}
+
+// Добавляет элемент value в дерево и возвращает количество элементов, строго больших value
 int Treap::add(const int value)
 {
-	const auto new_node = new TreapNode(value);
-	const auto pair = split(root, value);
-	const auto greater_elements_count = get_size(pair.second);
-	const auto new_left = merge(pair.first, new_node);
-	new_left->subtree_size = get_size(new_left);
-	root = merge(new_left, pair.second);
-	root->subtree_size = get_size(root);
+	return insert_node(root, create_node(value));
+}
+
+// Спускаемся до места, где приоритет нового узла выше, по пути считая большие элементы,
+// и разделяем только оставшееся поддерево - вместо разделения и двух слияний всего дерева
+int Treap::insert_node(node_index& subtree, node_index added)
+{
+	const int value = nodes[added].value;
+	int greater_elements_count = 0;
+	node_index* link = &subtree;
+	while (*link != no_node && nodes[*link].priority >= nodes[added].priority)
+	{
+		TreapNode& node = nodes[*link];
+		++node.subtree_size;
+		if (node.value <= value)
+		{
+			link = &node.right;
+		}
+		else
+		{
+			greater_elements_count += get_size(node.right) + 1;
+			link = &node.left;
+		}
+	}
+	const auto pair = split(*link, value);
+	greater_elements_count += get_size(pair.second);
+	nodes[added].left = pair.first;
+	nodes[added].right = pair.second;
+	update_size(added);
+	*link = added;
 	return greater_elements_count;
 }
 
+// Удаляет все элементы, равные value
 void Treap::remove(const int value)
 {
-	const auto pair = split(root, value - 1);
-	const auto new_left = pair.first;
-	const auto right_split = split(pair.second, value);
-	root = merge(new_left, right_split.second);
-	root->subtree_size = get_size(root);
+	while (true)
+	{
+		node_index* link = &root;
+		while (*link != no_node && nodes[*link].value != value)
+		{
+			path.push_back(*link);
+			link = nodes[*link].value < value ? &nodes[*link].right : &nodes[*link].left;
+		}
+		if (*link == no_node)
+		{
+			path.clear();
+			return;
+		}
+		// Найденный узел заменяется слиянием его поддеревьев, а пройденные узлы теряют по одному элементу
+		for (const node_index node : path)
+			--nodes[node].subtree_size;
+		path.clear();
+		const node_index removed = *link;
+		*link = merge(nodes[removed].left, nodes[removed].right);
+		free_node(removed);
+	}
+}
+
+int Treap::remove_k_order_statistic(int k)
+{
+	node_index* link = &root;
+	while (true)
+	{
+		TreapNode& node = nodes[*link];
+		const int left_size = get_size(node.left);
+		if (left_size == k)
+			break;
+		--node.subtree_size;
+		if (left_size > k)
+		{
+			link = &node.left;
+		}
+		else
+		{
+			k -= left_size + 1;
+			link = &node.right;
+		}
+	}
+	const node_index removed = *link;
+	const int value = nodes[removed].value;
+	*link = merge(nodes[removed].left, nodes[removed].right);
+	free_node(removed);
+	return value;
 }
 
 // Возвращает количество узлов в поддереве node
-int Treap::get_size(TreapNode* node)
+int Treap::get_size(node_index node) const
 {
-	if (!node) return 0;
-	int size = 1;
-	if (node->left)
-		size += node->left->subtree_size;
-	if (node->right)
-		size += node->right->subtree_size;
-	return size;
+	return node == no_node ? 0 : nodes[node].subtree_size;
 }
 
-// Возвращает значение элемента, стоящего в позиции k при сортировке по возрастанию
-int Treap::get_k_order_statistic(const int k) const
+void Treap::update_size(node_index node)
 {
-	return get_k_order_statistic(root, k);
+	nodes[node].subtree_size = get_size(nodes[node].left) + get_size(nodes[node].right) + 1;
 }
 
-int Treap::get_k_order_statistic(TreapNode* node, const int k)
+// Возвращает значение элемента, стоящего в позиции k при сортировке по возрастанию
+int Treap::get_k_order_statistic(int k) const
 {
-	if (get_size(node->left) == k)
-		return node->value;
-	if (get_size(node->left) > k)
-		return get_k_order_statistic(node->left, k);
-	return get_k_order_statistic(node->right, k - get_size(node->left) - 1);
+	node_index node = root;
+	while (true)
+	{
+		const int left_size = get_size(nodes[node].left);
+		if (left_size == k)
+			return nodes[node].value;
+		if (left_size > k)
+		{
+			node = nodes[node].left;
+		}
+		else
+		{
+			k -= left_size + 1;
+			node = nodes[node].right;
+		}
+	}
 }
 
 // Количество элементов в дереве
 int Treap::size() const
 {
-	return root->subtree_size;
+	return get_size(root);
 }
 
-int main()
+// Команда прапорщику: type == 1 - солдат ростом value приходит в строй, иначе уходит солдат с места value
+struct Command
 {
-	std::ios_base::sync_with_stdio(false);
-	std::cin.tie(nullptr);
-	srand(42);
+	int type;
+	int value;
+};
 
-	int n = 0;
-	std::cin >> n;
+// Выполняет команду над упорядоченным множеством ростов set (Treap, FenwickRankSet или CountedBPlusTree):
+// для пришедшего солдата вызывает on_position(position) с его местом в строю, для ушедшего - on_removed(height) с его ростом
+template <class OrderedSet, class Output, class Removed>
+void process_command(const Command& command, OrderedSet& set, Output on_position, Removed on_removed)
+{
+	if (command.type == 1) // солдат ростом value приходит в строй
+		on_position(set.add(command.value));
+	else // солдата на месте value надо удалить из строя
+		on_removed(set.remove_k_order_statistic(set.size() - 1 - command.value));
+}
+
+template <class OrderedSet, class Output, class Removed>
+void process_commands(const std::vector<Command>& commands, OrderedSet& set, Output on_position, Removed on_removed)
+{
+	for (const Command& command : commands)
+		process_command(command, set, on_position, on_removed);
+}
 
-	Treap treap;
+// Все роста, которые встречаются в командах, - набор значений для FenwickRankSet
+std::vector<int> collect_heights(const std::vector<Command>& commands)
+{
+	std::vector<int> heights;
+	for (const Command& command : commands)
+		if (command.type == 1)
+			heights.push_back(command.value);
+	return heights;
+}
 
+// Поток из n команд, в котором уходит каждая из 40% команд: random - случайные роста и места уходящих,
+// queue - каждый следующий солдат ниже всех (наивное дерево поиска вырождается в список), а уходят самые высокие,
+// stack - то же, но уходят самые низкие, и все изменения приходятся на один край строя
+std::vector<Command> generate_commands(int n, const std::string& kind)
+{
+	std::mt19937 generator(42);
+	std::vector<Command> commands;
+	commands.reserve(n);
+	int line_size = 0;
+	int next_height = 1000000000;
+	// Полос ростов не больше, чем помещается в int: рост полосы band - band * n + i
+	const int bands_count = std::max(1, std::min(1000, INT_MAX / std::max(n, 1)));
 	for (int i = 0; i < n; ++i)
 	{
-		int command = 0;
-		int value = 0;
-		std::cin >> command >> value;
-		if (command == 1) // солдат ростом value приходит в строй
+		if (line_size > 1 && generator() % 5 < 2)
 		{
-			int position = treap.add(value);
-			std::cout << position << " ";
+			int position = 0;
+			if (kind == "random")
+				position = static_cast<int>(generator() % line_size);
+			else if (kind == "stack")
+				position = line_size - 1;
+			commands.push_back(Command{ 2, position });
+			--line_size;
 		}
-		else // солдата на месте value надо удалить из строя
+		else
 		{
-			int height = treap.get_k_order_statistic(treap.size() - 1 - value); // Рост солдата в позиции value
-			treap.remove(height);
+			// Роста не повторяются: случайный рост берётся из своей полосы значений
+			const int height = kind == "random" ? static_cast<int>(generator() % bands_count) * n + i : next_height--;
+			commands.push_back(Command{ 1, height });
+			++line_size;
 		}
 	}
+	return commands;
+}
+
+// Время выполнения n команд каждым из трёх множеств на каждом виде потока.
+// Время FenwickRankSet включает сбор и сортировку набора ростов. Контрольные суммы выданных мест и ростов ушедших должны совпадать
+void run_benchmark(int n)
+{
+	std::cout << "commands\ttreap ms\tfenwick ms\tb+tree ms\tchecksums\n";
+	for (const std::string kind : { "random", "queue", "stack" })
+	{
+		const std::vector<Command> commands = generate_commands(n, kind);
+		// Время выполнения run в миллисекундах и контрольная сумма выданных мест и ростов ушедших
+		const auto measure = [&commands](auto run)
+		{
+			uint64_t checksum = 0;
+			const auto add_to_checksum = [&checksum](int value) { checksum = checksum * 31 + static_cast<uint32_t>(value); };
+			const auto start_time = std::chrono::steady_clock::now();
+			run(add_to_checksum);
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+			return std::make_pair(elapsed.count(), checksum);
+		};
+		const auto treap_result = measure([&](auto on_position)
+		{
+			Treap treap;
+			treap.reserve(n);
+			process_commands(commands, treap, on_position, on_position);
+		});
+		const auto fenwick_result = measure([&](auto on_position)
+		{
+			FenwickRankSet fenwick(collect_heights(commands));
+			process_commands(commands, fenwick, on_position, on_position);
+		});
+		const auto bplus_tree_result = measure([&](auto on_position)
+		{
+			CountedBPlusTree tree;
+			process_commands(commands, tree, on_position, on_position);
+		});
+		std::cout << kind << "\t" << treap_result.first << "\t" << fenwick_result.first << "\t" << bplus_tree_result.first
+			<< "\t" << treap_result.second << " " << fenwick_result.second << " " << bplus_tree_result.second << "\n";
+	}
+}
+
+// Время добавления n случайных чисел, пришедших отсортированными пакетами по batch_size, по одному и пакетами,
+// удаления половины из них по одному и пакетами, и построения дерева из всех n отсортированных чисел
+void run_batch_benchmark(int n, int batch_size)
+{
+	std::mt19937 generator(42);
+	std::vector<int> values(n);
+	for (int& value : values)
+		value = static_cast<int>(generator() % 1000000000);
+	for (int begin = 0; begin < n; begin += batch_size)
+		std::sort(values.begin() + begin, values.begin() + std::min(n, begin + batch_size));
+	const int erased_count = n / 2;
+
+	// Время выполнения run в миллисекундах
+	const auto measure = [](auto run)
+	{
+		const auto start_time = std::chrono::steady_clock::now();
+		run();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+		return elapsed.count();
+	};
+	Treap single;
+	Treap batched;
+	const double add_time = measure([&]
+	{
+		for (const int value : values)
+			single.add(value);
+	});
+	const double insert_batch_time = measure([&]
+	{
+		for (int begin = 0; begin < n; begin += batch_size)
+			batched.insert_batch(values.data() + begin, std::min(batch_size, n - begin));
+	});
+	const double remove_time = measure([&]
+	{
+		for (int i = 0; i < erased_count; ++i)
+			single.remove(values[i]);
+	});
+	const double erase_batch_time = measure([&]
+	{
+		for (int begin = 0; begin < erased_count; begin += batch_size)
+			batched.erase_batch(values.data() + begin, std::min(batch_size, erased_count - begin));
+	});
+	std::sort(values.begin(), values.end());
+	const double build_time = measure([&]
+	{
+		Treap built;
+		built.build_from_sorted(values.data(), n);
+	});
+
+	std::cout << "add " << add_time << " ms, insert_batch " << insert_batch_time << " ms\n"
+		<< "remove " << remove_time << " ms, erase_batch " << erase_batch_time << " ms\n"
+		<< "build_from_sorted " << build_time << " ms\n"
+		<< "sizes " << single.size() << " " << batched.size() << "\n";
+}
+
+// --backend treap|fenwick|btree выбирает множество ростов. Treap и btree выполняют команды по мере чтения,
+// fenwick читает все команды заранее, чтобы собрать набор ростов. --benchmark [n] и --batch-benchmark [n] [batch] запускают замеры
+int main(int argc, char* argv[])
+{
+	std::ios_base::sync_with_stdio(false);
+	std::cin.tie(nullptr);
+
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+	{
+		run_benchmark(argc > 2 ? std::atoi(argv[2]) : 1000000);
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--batch-benchmark") == 0)
+	{
+		run_batch_benchmark(argc > 2 ? std::atoi(argv[2]) : 1000000, argc > 3 ? std::atoi(argv[3]) : 4096);
+		return 0;
+	}
+	std::string backend = "treap";
+	if (argc > 1 && std::strcmp(argv[1], "--backend") == 0)
+	{
+		backend = argc > 2 ? argv[2] : "";
+		if (backend != "treap" && backend != "fenwick" && backend != "btree")
+		{
+			std::cerr << "Unknown backend '" << backend << "', expected treap, fenwick or btree\n";
+			return 1;
+		}
+	}
+
+	int n = 0;
+	std::cin >> n;
+	const auto read_command = []()
+	{
+		Command command{ 0, 0 };
+		std::cin >> command.type >> command.value;
+		return command;
+	};
+	const auto print_position = [](int position)
+	{
+		std::cout << position << " ";
+	};
+	const auto ignore_removed = [](int) {};
+	if (backend == "fenwick")
+	{
+		std::vector<Command> commands(n);
+		for (Command& command : commands)
+			command = read_command();
+		FenwickRankSet fenwick(collect_heights(commands));
+		process_commands(commands, fenwick, print_position, ignore_removed);
+	}
+	else if (backend == "btree")
+	{
+		CountedBPlusTree tree;
+		for (int i = 0; i < n; ++i)
+			process_command(read_command(), tree, print_position, ignore_removed);
+	}
+	else
+	{
+		Treap treap;
+		treap.reserve(n);
+		for (int i = 0; i < n; ++i)
+			process_command(read_command(), treap, print_position, ignore_removed);
+	}
 
 	std::cout.flush();
 	return 0;
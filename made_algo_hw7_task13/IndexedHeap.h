@@ -0,0 +1,199 @@
+﻿#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Адресуемая D-арная куча: push выдаёт дескриптор элемента, по которому можно уменьшить его приоритет или удалить его.
+// Дескрипторы выдаются подряд начиная с нуля и не переиспользуются, поэтому их удобно использовать как индексы в массивах вызывающего.
+// На вершине находится элемент с минимальным в смысле Compare приоритетом.
+template <class Priority, size_t D = 4, class Compare = std::less<Priority>>
+class IndexedHeap
+{
+	static_assert(D >= 2, "Heap arity must be at least 2");
+
+public:
+	typedef size_t handle;
+
+	explicit IndexedHeap(Compare compare = Compare()) : compare(compare)
+	{
+	}
+
+	// Проверка на пустоту
+	bool empty() const;
+	// Количество элементов
+	int size() const;
+	// Добавляет элемент с приоритетом priority и возвращает его дескриптор
+	handle push(Priority priority);
+	// Дескриптор элемента с минимальным приоритетом
+	handle top() const;
+	// Минимальный приоритет
+	const Priority& top_priority() const;
+	// Извлекает элемент с минимальным приоритетом и возвращает его дескриптор
+	handle pop();
+	// Находится ли элемент в куче (не был извлечён или удалён)
+	bool contains(handle element) const;
+	// Текущий приоритет элемента, находящегося в куче
+	const Priority& priority(handle element) const;
+	// Уменьшает приоритет элемента до priority. Новый приоритет не должен быть больше текущего
+	void decrease_key(handle element, Priority priority);
+	// Удаляет элемент из кучи
+	void erase(handle element);
+
+private:
+	static constexpr size_t absent = static_cast<size_t>(-1);
+
+	struct Entry
+	{
+		Priority priority;
+		handle element;
+	};
+
+	std::vector<Entry> heap; // Приоритеты хранятся рядом с дескрипторами, чтобы сравнения не обращались к другим массивам
+	std::vector<size_t> positions; // Позиция каждого элемента в heap или absent
+	Compare compare;
+
+	// Записывает entry в позицию position и запоминает её
+	void place(size_t position, Entry&& entry);
+	// Поднимает entry из позиции-«дырки» position
+	void sift_up(size_t position, Entry entry);
+	// Спускает entry из позиции-«дырки» position
+	void sift_down(size_t position, Entry entry);
+	// Удаляет элемент, находящийся в позиции position
+	void remove_at(size_t position);
+};
+
+template <class Priority, size_t D, class Compare>
+bool IndexedHeap<Priority, D, Compare>::empty() const
+{
+	return heap.empty();
+}
+
+template <class Priority, size_t D, class Compare>
+int IndexedHeap<Priority, D, Compare>::size() const
+{
+	return static_cast<int>(heap.size());
+}
+
+template <class Priority, size_t D, class Compare>
+typename IndexedHeap<Priority, D, Compare>::handle IndexedHeap<Priority, D, Compare>::push(Priority priority)
+{
+	const handle element = positions.size();
+	positions.push_back(heap.size());
+	heap.emplace_back();
+	sift_up(heap.size() - 1, Entry{ std::move(priority), element });
+	return element;
+}
+
+template <class Priority, size_t D, class Compare>
+typename IndexedHeap<Priority, D, Compare>::handle IndexedHeap<Priority, D, Compare>::top() const
+{
+	assert(!empty());
+	return heap[0].element;
+}
+
+template <class Priority, size_t D, class Compare>
+const Priority& IndexedHeap<Priority, D, Compare>::top_priority() const
+{
+	assert(!empty());
+	return heap[0].priority;
+}
+
+template <class Priority, size_t D, class Compare>
+typename IndexedHeap<Priority, D, Compare>::handle IndexedHeap<Priority, D, Compare>::pop()
+{
+	assert(!empty());
+	const handle element = heap[0].element;
+	remove_at(0);
+	return element;
+}
+
+template <class Priority, size_t D, class Compare>
+bool IndexedHeap<Priority, D, Compare>::contains(handle element) const
+{
+	return element < positions.size() && positions[element] != absent;
+}
+
+template <class Priority, size_t D, class Compare>
+const Priority& IndexedHeap<Priority, D, Compare>::priority(handle element) const
+{
+	assert(contains(element));
+	return heap[positions[element]].priority;
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::decrease_key(handle element, Priority priority)
+{
+	assert(contains(element));
+	const size_t position = positions[element];
+	assert(!compare(heap[position].priority, priority));
+	sift_up(position, Entry{ std::move(priority), element });
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::erase(handle element)
+{
+	assert(contains(element));
+	remove_at(positions[element]);
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::remove_at(size_t position)
+{
+	positions[heap[position].element] = absent;
+	Entry last = std::move(heap.back());
+	heap.pop_back();
+	if (position == heap.size())
+		return;
+	// Последний элемент встаёт на место удалённого и может пойти как вверх, так и вниз
+	if (position > 0 && compare(last.priority, heap[(position - 1) / D].priority))
+		sift_up(position, std::move(last));
+	else
+		sift_down(position, std::move(last));
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::place(size_t position, Entry&& entry)
+{
+	positions[entry.element] = position;
+	heap[position] = std::move(entry);
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::sift_up(size_t position, Entry entry)
+{
+	while (position > 0)
+	{
+		const size_t parent = (position - 1) / D;
+		if (!compare(entry.priority, heap[parent].priority))
+			break;
+		place(position, std::move(heap[parent]));
+		position = parent;
+	}
+	place(position, std::move(entry));
+}
+
+template <class Priority, size_t D, class Compare>
+void IndexedHeap<Priority, D, Compare>::sift_down(size_t position, Entry entry)
+{
+	const size_t end = heap.size();
+	while (true)
+	{
+		const size_t first = D * position + 1;
+		if (first >= end)
+			break;
+		const size_t last = std::min(first + D, end);
+		size_t best = first;
+		for (size_t child = first + 1; child < last; ++child)
+			if (compare(heap[child].priority, heap[best].priority))
+				best = child;
+		if (!compare(heap[best].priority, entry.priority))
+			break;
+		place(position, std::move(heap[best]));
+		position = best;
+	}
+	place(position, std::move(entry));
+}
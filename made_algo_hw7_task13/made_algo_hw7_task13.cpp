@@ -2,14 +2,12 @@
 // Написать алгоритм для решения игры в “пятнашки”
 // Достаточно найти хотя бы какое-то решение. Число перемещений костяшек не обязано быть минимальным.
 
+#include "IndexedHeap.h"
 #include <iostream>
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
-#include <queue>
 #include <unordered_map>
-#include <climits>
-#include <unordered_set>
 
 constexpr int field_size = 16;
 
@@ -18,7 +16,6 @@ struct position
 {
 	std::vector<char> cells; // Значения ячеек при построчном обходе слева направо сверху вниз
 	char empty_index = field_size-1; // Индекс пустой ячейки в векторе cells
-	int priority = INT_MAX; // Приоритет для хранения в MinHeap
 
 	bool is_final() const; // Является ли позиция искомой
 	bool is_solvable() const; // Достижима ли финальная позиция из текущей
@@ -200,50 +197,51 @@ char get_move_symbol(const position& from, const position& to)
 	}
 }
 
-// Компаратор для очереди с приоритетами
-// Будем извлекать позиции с минимальным приоритетом
-bool priority_comparator (const position& p1, const position& p2)
-{
-	return p1.priority > p2.priority;
-}
-
-// Алгоритм A*. В основе лежит алгоритм Дейкстры, не использующий decrease_key.
-// Вместо этого извлечённые из очереди вершины помещаются в unordered_set, а при повторном извлечении игнорируются.
-// Это не изменяет асимптотику алгоритма: под знаком логарифма оказывается |E| вместо |V|, O(log|E|)=O(log|V|^2)=O(2log|V|)=O(log|V|)
+// Алгоритм A*. В основе лежит алгоритм Дейкстры с decrease_key на адресуемой куче:
+// каждая позиция попадает в очередь ровно один раз, а при нахождении более короткого пути её приоритет уменьшается.
+// Дескриптор позиции в куче служит и её номером в массивах distance и states.
 // Значение heuristic_weight=1 сохраняет эвристику допустимой и позволяет найти кратчайший путь
 // Значения heuristic_weight>1 могут нарушить допустимость эвристики. Это может привести к нахождению неоптимлаьного пути,
-// но, как правило, путь будет найден быстрее
+// но, как правило, путь будет найден быстрее. Извлечённые позиции повторно не раскрываются
 void a_star(position& start, std::unordered_map<position, position>& parents, int heuristic_weight)
 {
-	std::unordered_map<position, int> distance; // Расстояния от стартовой вершины по числу рёбер
-	std::unordered_set<position> extracted; // Была ли позиция извлечена из очереди (т.е. вычислено ли для неё кратчайшее расстояние от старта)
-	distance[start] = 0;
-	
-	std::priority_queue<position, std::vector<position>, decltype(&priority_comparator)> positions_queue(priority_comparator);
-	start.priority = 0;
-	positions_queue.push(start);
-	
+	IndexedHeap<int> positions_queue;
+	std::unordered_map<position, IndexedHeap<int>::handle> handles; // Дескрипторы всех обнаруженных позиций
+	std::vector<const position*> states; // Позиция по дескриптору (ключи unordered_map не перемещаются)
+	std::vector<int> distance; // Расстояния от стартовой вершины по числу рёбер
+
+	const auto discover = [&](const position& pos, int pos_distance)
+	{
+		const auto element = positions_queue.push(pos_distance + heuristic_weight * heuristic(pos));
+		states.push_back(&handles.emplace(pos, element).first->first);
+		distance.push_back(pos_distance);
+	};
+	discover(start, 0);
+
 	while (!positions_queue.empty())
 	{
-		position current = positions_queue.top();
-		positions_queue.pop();
-		if (extracted.count(current)) // Позиция извлекалась ранее
-			continue;
+		const auto current_handle = positions_queue.pop();
+		const position& current = *states[current_handle];
 		if (current.is_final())
 			return;
-		
-		extracted.insert(current);
-		
-		for (position& neighbour : current.get_nearest_positions())
+		const int neighbour_distance = distance[current_handle] + 1;
+
+		for (const position& neighbour : current.get_nearest_positions())
 		{
-			if (distance.count(neighbour) == 0 || distance[neighbour] > distance[current] + 1)
+			const auto found = handles.find(neighbour);
+			if (found == handles.end())
+			{
+				parents[neighbour] = current;
+				discover(neighbour, neighbour_distance);
+			}
+			else if (distance[found->second] > neighbour_distance)
 			{
 				parents[neighbour] = current;
-				distance[neighbour] = distance[current] + 1;
-				neighbour.priority = distance[neighbour] + heuristic_weight * heuristic(neighbour);
-				positions_queue.push(neighbour);
+				distance[found->second] = neighbour_distance;
+				if (positions_queue.contains(found->second))
+					positions_queue.decrease_key(found->second, neighbour_distance + heuristic_weight * heuristic(neighbour));
 			}
-		 }
+		}
 	}
 }
 